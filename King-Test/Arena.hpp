@@ -0,0 +1,90 @@
+#ifndef Arena_hpp
+#define Arena_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that all live exactly as long as something else, such as the nodes of one search.
+//
+// Memory is handed out from large blocks by moving an offset forward, so creating an object costs a few instructions and
+// objects created one after another are next to each other in memory. Nothing is freed on its own: reset frees every object
+// at once and keeps the blocks for whatever is created next. The arena never calls a destructor, so whoever creates objects
+// that are not trivially destructible, such as objects holding a mutex or owning memory, must destroy them before the arena
+// is reset or destroyed. An arena must only be used by one thread at a time, objects in it can be read from any thread.
+class Arena {
+public:
+    static const size_t defaultBlockSize = 1 << 20;
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+
+    // Position of the next free byte, blocks after the current one are empty
+    size_t blockIndex = 0;
+    size_t offset = 0;
+
+    // Bytes handed out since the last reset, including the padding for alignment
+    size_t numberOfBytesUsed = 0;
+
+public:
+    Arena(size_t blockSize = defaultBlockSize): blockSize(blockSize) {}
+
+    void* allocate(size_t size, size_t alignment) {
+        while (blockIndex < blocks.size()) {
+            auto& block = blocks[blockIndex];
+            auto address = (uintptr_t)(block.memory.get() + offset);
+            auto padding = (alignment - address % alignment) % alignment;
+            if (offset + padding + size <= block.size) {
+                offset += padding + size;
+                numberOfBytesUsed += padding + size;
+                return (void*)(address + padding);
+            }
+            blockIndex++;
+            offset = 0;
+        }
+
+        // Objects larger than a block get a block of their own
+        Block block;
+        block.size = std::max(blockSize, size + alignment);
+        block.memory.reset(new uint8_t[block.size]);
+        blocks.push_back(std::move(block));
+        blockIndex = blocks.size() - 1;
+        return allocate(size, alignment);
+    }
+
+    template<typename T, typename... Arguments>
+    T* make(Arguments&&... arguments) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Arguments>(arguments)...);
+    }
+
+    // Frees every object in the arena, the memory is reused by the objects created after it
+    void reset() {
+        blockIndex = 0;
+        offset = 0;
+        numberOfBytesUsed = 0;
+    }
+
+    size_t bytesUsed() const {
+        return numberOfBytesUsed;
+    }
+
+    // Bytes held by the arena, used or not
+    size_t bytesReserved() const {
+        size_t size = 0;
+        for (auto& block: blocks) {
+            size += block.size;
+        }
+        return size;
+    }
+};
+
+#endif /* Arena_hpp */
@@ -0,0 +1,171 @@
+// Headless benchmark of the game logic, it only depends on CandyCrush.cpp and Trace.cpp and needs neither SDL nor a display.
+//
+// Build and run:
+//     clang++ -std=c++14 -O2 CandyCrush.cpp Trace.cpp Benchmark.cpp -o benchmark
+//     ./benchmark [seed] [samples]
+//
+// Every benchmark prints one JSON object per line so that results can be collected and compared between releases.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "CandyCrush.hpp"
+
+struct CandyCrushBenchmark {
+
+    static bool performMove(CandyCrush& game, GameBoard::CellSwapMove move) {
+        return game.performMove(move, CandyCrush::NoCallback());
+    }
+
+    static void clearAllMatches(CandyCrush& game) {
+        game.clearAllMatches(CandyCrush::NoCallback());
+    }
+
+    static void updateLegalMoves(CandyCrush& game) {
+        game.updateLegalMoves();
+    }
+};
+
+// Keeps the compiler from optimizing away results that are otherwise unused
+static volatile long benchmarkSink = 0;
+
+struct BenchmarkResult {
+    std::string name;
+    std::vector<double> nanosecondsPerOperation;
+    long numberOfOperations = 0;
+    double totalSeconds = 0;
+
+    double percentile(double fraction) const {
+        auto sorted = nanosecondsPerOperation;
+        std::sort(sorted.begin(), sorted.end());
+        auto index = (size_t)(fraction * (sorted.size() - 1));
+        return sorted[index];
+    }
+
+    void print(std::ostream& os) const {
+        os << "{\"benchmark\": \"" << name << "\""
+        << ", \"operations\": " << numberOfOperations
+        << ", \"operationsPerSecond\": " << (long)(numberOfOperations / totalSeconds)
+        << ", \"p50Nanoseconds\": " << percentile(0.5)
+        << ", \"p90Nanoseconds\": " << percentile(0.9)
+        << ", \"p99Nanoseconds\": " << percentile(0.99)
+        << ", \"maxNanoseconds\": " << percentile(1.0)
+        << "}" << std::endl;
+    }
+};
+
+// Times numberOfSamples batches of operationsPerSample calls. Each batch first gets a fresh set of inputs from prepare,
+// which is not timed, and then runs operation once for every input. Latencies are reported per operation.
+template<typename Input, typename Prepare, typename Operation>
+BenchmarkResult runBenchmark(std::string name, int numberOfSamples, int operationsPerSample, Prepare prepare, Operation operation) {
+    BenchmarkResult result;
+    result.name = name;
+    std::vector<Input> inputs;
+    for (auto sample = 0; sample < numberOfSamples; sample++) {
+        inputs.clear();
+        for (auto i = 0; i < operationsPerSample; i++) {
+            inputs.push_back(prepare(sample*operationsPerSample + i));
+        }
+        auto startTime = std::chrono::steady_clock::now();
+        for (auto& input: inputs) {
+            operation(input);
+        }
+        auto endTime = std::chrono::steady_clock::now();
+        double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(endTime-startTime).count();
+        result.nanosecondsPerOperation.push_back(nanoseconds / operationsPerSample);
+        result.numberOfOperations += operationsPerSample;
+        result.totalSeconds += nanoseconds / 1e9;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    const uint64_t seed = argc > 1 ? std::stoull(argv[1]) : 1;
+    const int numberOfSamples = argc > 2 ? std::stoi(argv[2]) : 200;
+    const int operationsPerSample = 100;
+
+    // A fixed set of boards played a few moves in, generated from the seed so that every run measures the same positions
+    RandomGenerator randomGenerator(seed);
+    std::vector<CandyCrush> games;
+    while (games.size() < 1000) {
+        CandyCrush game(randomGenerator.next());
+        for (auto i = 0; i < (int)games.size() % 10 && game.hasLegalMoves(); i++) {
+            auto moves = game.legalMoves();
+            game.play(moves[randomGenerator.nextBelow((uint32_t)moves.size())]);
+        }
+        if (game.hasLegalMoves()) {
+            games.push_back(game);
+        }
+    }
+    auto gameAt = [&](int index) -> const CandyCrush& {
+        return games[index % games.size()];
+    };
+    auto legalMoveAt = [&](int index) {
+        auto moves = gameAt(index).legalMoves();
+        return moves[(index / games.size()) % moves.size()];
+    };
+
+    std::vector<BenchmarkResult> results;
+
+    results.push_back(runBenchmark<int>("CandyCrush()", numberOfSamples, operationsPerSample, [&](int index) {
+        return index;
+    }, [&](int index) {
+        CandyCrush game(seed + index);
+        benchmarkSink += game.getScore();
+    }));
+
+    results.push_back(runBenchmark<std::pair<CandyCrush, GameBoard::CellSwapMove>>("performMove", numberOfSamples, operationsPerSample, [&](int index) {
+        return std::make_pair(gameAt(index), legalMoveAt(index));
+    }, [&](std::pair<CandyCrush, GameBoard::CellSwapMove>& input) {
+        benchmarkSink += CandyCrushBenchmark::performMove(input.first, input.second);
+    }));
+
+    results.push_back(runBenchmark<std::pair<CandyCrush, GameBoard::CellSwapMove>>("performMove (illegal)", numberOfSamples, operationsPerSample, [&](int index) {
+        return std::make_pair(gameAt(index), GameBoard::CellSwapMove({0, 0}, {0, 1}));
+    }, [&](std::pair<CandyCrush, GameBoard::CellSwapMove>& input) {
+        benchmarkSink += CandyCrushBenchmark::performMove(input.first, input.second);
+    }));
+
+    // Boards right after a move, before the cascades it caused have been cleared
+    results.push_back(runBenchmark<CandyCrush>("clearAllMatches", numberOfSamples, operationsPerSample, [&](int index) {
+        auto game = gameAt(index);
+        CandyCrushBenchmark::performMove(game, legalMoveAt(index));
+        return game;
+    }, [&](CandyCrush& game) {
+        CandyCrushBenchmark::clearAllMatches(game);
+        benchmarkSink += game.getScore();
+    }));
+
+    results.push_back(runBenchmark<CandyCrush>("updateLegalMoves", numberOfSamples, operationsPerSample, [&](int index) {
+        return gameAt(index);
+    }, [&](CandyCrush& game) {
+        CandyCrushBenchmark::updateLegalMoves(game);
+        benchmarkSink += game.hasLegalMoves();
+    }));
+
+    results.push_back(runBenchmark<int>("legalMoves", numberOfSamples, operationsPerSample, [&](int index) {
+        return index;
+    }, [&](int index) {
+        benchmarkSink += gameAt(index).legalMoves().size();
+    }));
+
+    results.push_back(runBenchmark<int>("isLegalMove", numberOfSamples, operationsPerSample, [&](int index) {
+        return index;
+    }, [&](int index) {
+        auto cell = GameBoard::CellPosition(index % 8, (index / 8) % 7);
+        benchmarkSink += gameAt(index).isLegalMove(GameBoard::CellSwapMove(cell, GameBoard::CellPosition(cell.row, cell.column+1)));
+    }));
+
+    results.push_back(runBenchmark<std::pair<int, GameBoard::CellSwapMove>>("gameForMove", numberOfSamples, operationsPerSample, [&](int index) {
+        return std::make_pair(index, legalMoveAt(index));
+    }, [&](std::pair<int, GameBoard::CellSwapMove>& input) {
+        benchmarkSink += gameAt(input.first).gameForMove(input.second).getScore();
+    }));
+
+    for (const auto& result: results) {
+        result.print(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+#ifndef Bitboard_hpp
+#define Bitboard_hpp
+
+#include <cstdint>
+#include <type_traits>
+#include "GameBoard.hpp"
+
+namespace GameBoard {
+
+    // Boards of up to 64 cells fit in one 64 bit word, boards of up to 128 cells (9x9 and 10x10) in a 128 bit word
+    typedef __uint128_t WideMask;
+
+    inline size_t countBits(const uint64_t mask) {
+        return (size_t)__builtin_popcountll(mask);
+    }
+
+    inline size_t countBits(const WideMask mask) {
+        return countBits((uint64_t)mask) + countBits((uint64_t)(mask >> 64));
+    }
+
+    inline size_t lowestBit(const uint64_t mask) {
+        return (size_t)__builtin_ctzll(mask);
+    }
+
+    inline size_t lowestBit(const WideMask mask) {
+        return (uint64_t)mask != 0 ? lowestBit((uint64_t)mask) : 64 + lowestBit((uint64_t)(mask >> 64));
+    }
+
+    // Stores a game board as one mask per color, bit (row*COLUMNS + column) is set if the cell has that color.
+    // This makes it possible to find all matches on the board with a handful of shifts and ANDs instead of comparing cells one at a time.
+    template<size_t ROWS, size_t COLUMNS, size_t COLORS>
+    class Bitboard {
+        static_assert(ROWS*COLUMNS <= 128, "A bitboard can only hold boards with at most 128 cells");
+        static_assert(COLUMNS >= 3 && ROWS >= 3, "A bitboard needs room for three cells in a row");
+
+    public:
+        typedef typename std::conditional<ROWS*COLUMNS <= 64, uint64_t, WideMask>::type Mask;
+
+    private:
+        Mask masks[COLORS] = {};
+
+        // Bits where a horizontal run of three can start without wrapping into the next row
+        static constexpr Mask horizontalRunStartMask() {
+            Mask mask = 0;
+            for (size_t row = 0; row < ROWS; row++) {
+                for (size_t column = 0; column+2 < COLUMNS; column++) {
+                    mask |= Mask(1) << (row*COLUMNS + column);
+                }
+            }
+            return mask;
+        }
+
+    public:
+        static constexpr Mask boardMask() {
+            return ROWS*COLUMNS == 8*sizeof(Mask) ? ~Mask(0) : (Mask(1) << (ROWS*COLUMNS)) - 1;
+        }
+
+        static constexpr Mask cellMask(const CellPosition cell) {
+            return Mask(1) << (cell.row*COLUMNS + cell.column);
+        }
+
+        static constexpr Mask columnMask(const size_t column) {
+            Mask mask = 0;
+            for (size_t row = 0; row < ROWS; row++) {
+                mask |= Mask(1) << (row*COLUMNS + column);
+            }
+            return mask;
+        }
+
+        // All cells above the given cell in the same column
+        static constexpr Mask aboveCellMask(const CellPosition cell) {
+            return columnMask(cell.column) & (cellMask(cell) - 1);
+        }
+
+        // Cells whose neighbour in the given direction is in the mask
+        static Mask leftNeighbours(const Mask mask) {
+            return (mask >> 1) & ~columnMask(COLUMNS-1);
+        }
+
+        static Mask rightNeighbours(const Mask mask) {
+            return (mask << 1) & ~columnMask(0) & boardMask();
+        }
+
+        static Mask upperNeighbours(const Mask mask) {
+            return mask >> COLUMNS;
+        }
+
+        static Mask lowerNeighbours(const Mask mask) {
+            return (mask << COLUMNS) & boardMask();
+        }
+
+        static CellPosition cellForBit(const size_t bit) {
+            return CellPosition((int)(bit / COLUMNS), (int)(bit % COLUMNS));
+        }
+
+        static size_t countCells(const Mask mask) {
+            return countBits(mask);
+        }
+
+        static size_t firstBit(const Mask mask) {
+            return lowestBit(mask);
+        }
+
+        // Cells that are part of three or more consecutive cells on the same row
+        static Mask horizontalMatches(const Mask mask) {
+            auto runStarts = mask & (mask >> 1) & (mask >> 2) & horizontalRunStartMask();
+            return runStarts | (runStarts << 1) | (runStarts << 2);
+        }
+
+        // Cells that are part of three or more consecutive cells in the same column
+        static Mask verticalMatches(const Mask mask) {
+            auto runStarts = mask & (mask >> COLUMNS) & (mask >> 2*COLUMNS);
+            return runStarts | (runStarts << COLUMNS) | (runStarts << 2*COLUMNS);
+        }
+
+        // Calls action with the length of every run in a mask of matched cells, step is 1 for horizontal runs and COLUMNS for vertical runs.
+        // A horizontal run ends at the end of its row even if the next row starts with matched cells.
+        template<typename Action>
+        static void forEachRun(Mask matches, const size_t step, Action action) {
+            while (matches != 0) {
+                auto bit = firstBit(matches);
+                size_t length = 0;
+                while (bit < ROWS*COLUMNS && (matches & (Mask(1) << bit))) {
+                    matches &= ~(Mask(1) << bit);
+                    bit += step;
+                    length++;
+                    if (step == 1 && bit % COLUMNS == 0) {
+                        break;
+                    }
+                }
+                action(length);
+            }
+        }
+
+        Bitboard() {}
+
+        template<typename CellType, size_t CELL_TYPES>
+        Bitboard(const GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>& gameBoard) {
+            static_assert(CELL_TYPES <= COLORS, "Every cell type needs a mask");
+            for (size_t row = 0; row < ROWS; row++) {
+                for (size_t column = 0; column < COLUMNS; column++) {
+                    setCell(CellPosition((int)row, (int)column), (size_t)gameBoard[row][column]);
+                }
+            }
+        }
+
+        Mask operator[](const size_t color) const {
+            return masks[color];
+        }
+
+        Mask occupiedCells() const {
+            Mask mask = 0;
+            for (size_t color = 0; color < COLORS; color++) {
+                mask |= masks[color];
+            }
+            return mask;
+        }
+
+        void setCell(const CellPosition cell, const size_t color) {
+            auto bit = cellMask(cell);
+            for (size_t i = 0; i < COLORS; i++) {
+                masks[i] &= ~bit;
+            }
+            masks[color] |= bit;
+        }
+
+        void swapCells(const CellSwapMove move) {
+            auto fromBit = cellMask(move.from);
+            auto toBit = cellMask(move.to);
+            for (size_t color = 0; color < COLORS; color++) {
+                auto hasFrom = (masks[color] & fromBit) != 0;
+                auto hasTo = (masks[color] & toBit) != 0;
+                if (hasFrom != hasTo) {
+                    masks[color] ^= fromBit | toBit;
+                }
+            }
+        }
+
+        // All cells that are part of any horizontal or vertical match
+        Mask matchedCells() const {
+            Mask matches = 0;
+            for (size_t color = 0; color < COLORS; color++) {
+                matches |= horizontalMatches(masks[color]) | verticalMatches(masks[color]);
+            }
+            return matches;
+        }
+
+        // Every swap with the cell to the right (or below) that creates a match, as the mask of the top or left cells.
+        // Only valid when the board has no matches, so that every match after a swap goes through one of the swapped cells.
+        //
+        // A cell that gets a new color is matched if two cells next to it in a line have that color, not counting the cell it was
+        // swapped with. For a right swap the left cell can only be matched by the two cells to its left or by cells in its column,
+        // the right cell by the two cells to its right or by cells in its column, and the same goes for down swaps turned around.
+        void swapsCreatingMatch(Mask& rightSwaps, Mask& downSwaps) const {
+            rightSwaps = 0;
+            downSwaps = 0;
+            for (size_t color = 0; color < COLORS; color++) {
+                auto mask = masks[color];
+                auto left = rightNeighbours(mask);
+                auto right = leftNeighbours(mask);
+                auto above = lowerNeighbours(mask);
+                auto below = upperNeighbours(mask);
+
+                // Cells with two cells of the color on the given side, or one on each side
+                auto twoLeft = left & rightNeighbours(left);
+                auto twoRight = right & leftNeighbours(right);
+                auto twoAbove = above & lowerNeighbours(above);
+                auto twoBelow = below & upperNeighbours(below);
+                auto horizontalPair = left & right;
+                auto verticalPair = above & below;
+
+                auto vertical = twoAbove | twoBelow | verticalPair;
+                auto horizontal = twoLeft | twoRight | horizontalPair;
+                rightSwaps |= (right & (twoLeft | vertical)) | (mask & leftNeighbours(twoRight | vertical));
+                downSwaps |= (below & (twoAbove | horizontal)) | (mask & upperNeighbours(twoBelow | horizontal));
+            }
+        }
+
+        // Removes the given cells and lets everything above them fall down, the emptied cells at the top are left unset for refilling.
+        // Removing the cells from the top down means that each removal only shifts cells that have not been processed yet.
+        void removeCells(Mask removedCells) {
+            while (removedCells != 0) {
+                auto cell = cellForBit(firstBit(removedCells));
+                removedCells &= removedCells - 1;
+                auto above = aboveCellMask(cell);
+                auto removed = cellMask(cell);
+                for (size_t color = 0; color < COLORS; color++) {
+                    masks[color] = (masks[color] & ~(above | removed)) | ((masks[color] & above) << COLUMNS);
+                }
+            }
+        }
+
+        bool operator==(const Bitboard& bitboard) const {
+            for (size_t color = 0; color < COLORS; color++) {
+                if (masks[color] != bitboard.masks[color]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+}
+
+#endif /* Bitboard_hpp */
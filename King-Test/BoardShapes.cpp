@@ -0,0 +1,84 @@
+#include "BoardShapes.hpp"
+#include "CandyCrush.hpp"
+
+namespace {
+
+    // Plays the shape on the same engine as the classic game. The shapes have no time limit, so the game is on a virtual clock
+    // that never moves.
+    template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+    class FixedShapeGame: public BoardShapeGame {
+        CandyCrushGame<ROWS, COLUMNS, CELL_TYPES> game;
+
+    public:
+        FixedShapeGame(uint64_t seed): game(seed, CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::Clock::virtualClock(0)) {}
+
+        size_t rows() const override {
+            return ROWS;
+        }
+
+        size_t columns() const override {
+            return COLUMNS;
+        }
+
+        size_t numberOfCellTypes() const override {
+            return CELL_TYPES;
+        }
+
+        int cellAt(GameBoard::CellPosition cell) const override {
+            return game.getGameBoard()[cell];
+        }
+
+        int getScore() const override {
+            return game.getScore();
+        }
+
+        bool isLegalMove(GameBoard::CellSwapMove move) const override {
+            return game.isLegalMove(move);
+        }
+
+        bool hasLegalMoves() const override {
+            return game.hasLegalMoves();
+        }
+
+        std::vector<GameBoard::CellSwapMove> legalMoves() const override {
+            return game.legalMoves();
+        }
+
+        bool play(GameBoard::CellSwapMove move) override {
+            return game.play(move);
+        }
+
+        std::unique_ptr<BoardShapeGame> copy() const override {
+            return std::unique_ptr<BoardShapeGame>(new FixedShapeGame(*this));
+        }
+    };
+
+    template<size_t ROWS, size_t COLUMNS>
+    std::unique_ptr<BoardShapeGame> makeWithCellTypes(size_t numberOfCellTypes, uint64_t seed) {
+        switch (numberOfCellTypes) {
+            case 4: return std::unique_ptr<BoardShapeGame>(new FixedShapeGame<ROWS, COLUMNS, 4>(seed));
+            case 5: return std::unique_ptr<BoardShapeGame>(new FixedShapeGame<ROWS, COLUMNS, 5>(seed));
+            case 6: return std::unique_ptr<BoardShapeGame>(new FixedShapeGame<ROWS, COLUMNS, 6>(seed));
+            case 7: return std::unique_ptr<BoardShapeGame>(new FixedShapeGame<ROWS, COLUMNS, 7>(seed));
+            default: return nullptr;
+        }
+    }
+}
+
+bool BoardShapeGame::isShapeSupported(size_t rows, size_t columns, size_t numberOfCellTypes) {
+    auto isSizeSupported = rows == columns && (rows == 6 || rows == 8 || rows == 9 || rows == 10);
+    return isSizeSupported && numberOfCellTypes >= 4 && numberOfCellTypes <= 7;
+}
+
+std::unique_ptr<BoardShapeGame> BoardShapeGame::make(size_t rows, size_t columns, size_t numberOfCellTypes, uint64_t seed) {
+    if (!isShapeSupported(rows, columns, numberOfCellTypes)) {
+        return nullptr;
+    }
+    switch (rows) {
+        case 6: return makeWithCellTypes<6, 6>(numberOfCellTypes, seed);
+        case 8: return makeWithCellTypes<8, 8>(numberOfCellTypes, seed);
+        case 9: return makeWithCellTypes<9, 9>(numberOfCellTypes, seed);
+        case 10: return makeWithCellTypes<10, 10>(numberOfCellTypes, seed);
+        default: return nullptr;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef BoardShapes_hpp
+#define BoardShapes_hpp
+
+#include <memory>
+#include <vector>
+#include "GameBoard.hpp"
+
+// Game on a board with a different size or number of cell types than the classic 8x8 game, used by levels that need other shapes.
+// Every supported shape is an instance of CandyCrushGame with the size and number of cell types known at compile time, so it
+// plays by the same rules and finds matches with the same bitboard as the classic game. The shape is picked at runtime with make.
+class BoardShapeGame {
+public:
+    virtual ~BoardShapeGame() {}
+
+    virtual size_t rows() const = 0;
+    virtual size_t columns() const = 0;
+    virtual size_t numberOfCellTypes() const = 0;
+
+    // Cell types are numbered from zero
+    virtual int cellAt(GameBoard::CellPosition cell) const = 0;
+
+    virtual int getScore() const = 0;
+    virtual bool isLegalMove(GameBoard::CellSwapMove move) const = 0;
+    virtual bool hasLegalMoves() const = 0;
+    virtual std::vector<GameBoard::CellSwapMove> legalMoves() const = 0;
+
+    // Makes the move and clears all cascades it causes, returns whether the move was legal
+    virtual bool play(GameBoard::CellSwapMove move) = 0;
+
+    virtual std::unique_ptr<BoardShapeGame> copy() const = 0;
+
+    // Sizes 6x6, 8x8, 9x9 and 10x10 with 4 to 7 cell types are supported
+    static bool isShapeSupported(size_t rows, size_t columns, size_t numberOfCellTypes);
+
+    // Returns nullptr if the shape is not supported
+    static std::unique_ptr<BoardShapeGame> make(size_t rows, size_t columns, size_t numberOfCellTypes, uint64_t seed);
+};
+
+#endif /* BoardShapes_hpp */
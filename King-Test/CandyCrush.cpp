@@ -1,215 +1,388 @@
 #include "CandyCrush.hpp"
+#include <random>
+#include "Trace.hpp"
 
-CandyCrush::Cell CandyCrush::randomCell() {
-    std::vector<CandyCrush::Cell> cells = {Green, Blue, Purple, Red, Yellow};
-    return cells[rand() % cells.size()];
+// The cell types are numbered from zero so a random cell can be picked without listing them
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+typename CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::Cell CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::randomCell() {
+    return (Cell)randomGenerator.nextBelow(numberOfCellTypes);
 }
 
 // When randomly generating new cells some of them will create matches that must be cleared after each move and when initializing the game
-void CandyCrush::clearAllMatches(GameBoardChangeCallback callback) {
-    
-    // As long as doing nothing increases score we should keep doing it
-    auto doNothingMove = GameBoard::CellSwapMove(GameBoard::CellPosition(0,0), GameBoard::CellPosition(0,0));
-    while (performMove(doNothingMove, callback)) {}
-}
-
-bool CandyCrush::isLegalMove(GameBoard::CellSwapMove move) const {
-    // Perform the move on a copy of the game and returns whether it was valid or not
-    auto game = *this;
-    return game.performMove(move);
-}
-
-// Could have a more advanced score function where many matches are much more rewarded
-int CandyCrush::scoreForMatches(int numberOfMatches) const {
-    return numberOfMatches;
+// Returns the number of cascades, that is how many times matches had to be cleared before the board was stable
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+template<typename Callback>
+int CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::clearAllMatches(const Callback& callback) {
+    TRACE_SPAN("clearAllMatches");
+    auto findMatchedCells = [this] {
+        TRACE_SPAN("findMatches");
+        return bitboard.matchedCells();
+    };
+    auto numberOfCascades = 0;
+    for (auto matchedCells = findMatchedCells(); matchedCells != 0; matchedCells = findMatchedCells()) {
+        clearMatches(matchedCells, callback);
+        numberOfCascades++;
+    }
+    if (numberOfCascades > 0) {
+        boardGeneration++;
+        updateLegalMoves();
+    }
+    TRACE_COUNTER("cascadeWaves", numberOfCascades);
+    return numberOfCascades;
 }
 
-// Performs the move and returns where it was valid
-bool CandyCrush::performMove(GameBoard::CellSwapMove move, GameBoardChangeCallback callback) {
-    if (!gameBoard.areCellsAdjacent(move.from, move.to) && !(move.from == move.to)) {
-        return false;
-    }
-    
-    auto gameBoardChange = CandyCrushGameBoardChange(*this);
-    gameBoardChange.gameBoardChange[move.from] = {move.to, gameBoard[move.to]};
-    gameBoardChange.gameBoardChange[move.to] = {move.from, gameBoard[move.from]};
+// One wave of a cascade. All matched cells are removed at once, so a cell in both a horizontal and a vertical run (L, T and
+// cross shapes) is removed once, and every column is compacted once however many runs it has cells in.
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+template<typename Callback>
+void CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::clearMatches(typename CandyCrushBitboard::Mask matchedCells, const Callback& callback) {
+    TRACE_SPAN("clearMatches");
+    CascadeWave wave;
     
-    // This allows the caller to see the game board changes done so far, which currently is just a swap
-    if (callback != nullptr) {
-        callback(gameBoardChange);
+    // Each run of 3 or more consecutive cells gives score, a cell can be part of both a horizontal and a vertical run
+    const auto oldScore = score;
+    auto addScoreForRun = [&](size_t numberOfMatches) {
+        score += scoreForMatches((int)numberOfMatches);
+        wave.numberOfRuns++;
+    };
+    for (size_t cellType = 0; cellType < numberOfCellTypes; cellType++) {
+        CandyCrushBitboard::forEachRun(CandyCrushBitboard::horizontalMatches(bitboard[cellType]), 1, addScoreForRun);
+        CandyCrushBitboard::forEachRun(CandyCrushBitboard::verticalMatches(bitboard[cellType]), gameBoard.columns, addScoreForRun);
+    }
+    wave.numberOfRemovedCells = (uint8_t)CandyCrushBitboard::countCells(matchedCells);
+    wave.score = (uint16_t)(score - oldScore);
+    if (cascadeWavesInLastMove.size() < maximumNumberOfReportedWaves) {
+        cascadeWavesInLastMove.push_back(wave);
     }
     
-    // Needed to calculate if the score did increase at the end
-    const auto oldScore = score;
+    // The change set only lists the cells that change, it starts out empty
+    GameBoardChange gameBoardChange;
     
-    // Move pieces
-    gameBoard.swapCells(move);
+    // Matched cells will be removed
+    for (auto cells = matchedCells; cells != 0; cells &= cells - 1) {
+        auto removedCellPosition = CandyCrushBitboard::cellForBit(CandyCrushBitboard::firstBit(cells));
+        gameBoardChange.removedCells.push_back({removedCellPosition, gameBoard[removedCellPosition]});
+    }
     
-    // This resets the gameBoardChange so the swap won't be seen as a change by the caller next time
-    gameBoardChange = CandyCrushGameBoardChange(*this);
+    // Existing cells above the removed cells fall down, which leaves empty cells at the top of the affected columns
+    bitboard.removeCells(matchedCells);
     
-    // Horizontal matching – look for 3 or more consecutive columns on the same row with the same color
-    for (auto row = 0; row < gameBoard.rows; row++) {
-        int numberOfMatches = 0;
-        auto lastCell = gameBoard[row][0];
-        for (auto column = 0; column < gameBoard.columns; column++) {
-            auto currentCell = gameBoard[row][column];
-            auto cellsMatched = lastCell == currentCell;
-            if (cellsMatched) {
-                numberOfMatches++;
-            }
-            
-            // We should keep looking for more matches unless we find a non-matching cell or are at the end of the board
-            if (numberOfMatches >= 3 && (!cellsMatched || column == gameBoard.rows -1 )) {
-                score += scoreForMatches(numberOfMatches);
-                auto lastColumnThatMatched = cellsMatched ? column : column-1;
-                
-                for (auto matchedColumn = lastColumnThatMatched-numberOfMatches+1; matchedColumn <= lastColumnThatMatched; matchedColumn++) {
-                    
-                    // Matched columns will be removed
-                    GameBoard::CellPosition removedCellPosition = {row, matchedColumn};
-                    gameBoardChange.removedCells.push_back({removedCellPosition, gameBoard[removedCellPosition]});
-                    
-                    // Move existing cells above down one step
-                    for (auto matchedRow = row-1; matchedRow >= 0; matchedRow--) {
-                        GameBoard::CellPosition cellPosition = {matchedRow, matchedColumn};
-                        GameBoard::CellPosition newCellPosition = {matchedRow+1, matchedColumn};
-                        gameBoardChange.gameBoardChange[newCellPosition] = {cellPosition, gameBoard[cellPosition]};
-                    }
-                    
-                    // Create new cell at the top of the board and say it will come above the board (-1)
-                    gameBoardChange.gameBoardChange[{0, matchedColumn}] = {{-1, matchedColumn}, randomCell()};
-                }
-            }
-            if (!cellsMatched) {
-                numberOfMatches = 1;
-            }
-            
-            lastCell = gameBoard[row][column];
-        }
-    }
-    // Vertical matching – look for 3 or more consecutive rows in same column with the same color
     for (auto column = 0; column < gameBoard.columns; column++) {
-        int numberOfMatches = 0;
-        auto lastCell = gameBoard[0][column];
-        for (auto row = 0; row < gameBoard.rows; row++) {
-            auto currentCell = gameBoard[row][column];
-            auto cellsMatched = lastCell == currentCell;
-            if (cellsMatched) {
-                numberOfMatches++;
-            }
-            if (numberOfMatches >= 3 && (!cellsMatched || row == gameBoard.rows-1)) {
-                score += scoreForMatches(numberOfMatches);
-                int firstPreviousRowNotMatching = cellsMatched ? row-numberOfMatches : row-numberOfMatches-1;
-                
-                for (auto i = firstPreviousRowNotMatching+1; i <= firstPreviousRowNotMatching+numberOfMatches; i++) {
-                    GameBoard::CellPosition removedCellPosition = {i, column};
-                    gameBoardChange.removedCells.push_back({removedCellPosition, gameBoard[removedCellPosition]});
-                }
-                
-                // Move down already existing cells from above
-                while (firstPreviousRowNotMatching >= 0) {
-                    GameBoard::CellPosition cellPosition = {firstPreviousRowNotMatching, column};
-                    GameBoard::CellPosition newCellPosition = {firstPreviousRowNotMatching+numberOfMatches, column};
-                    gameBoardChange.gameBoardChange[newCellPosition] = {cellPosition, gameBoard[cellPosition]};
-                    firstPreviousRowNotMatching--;
-                }
-                
-                // Add new cells at the top and say that they will come from above the board
-                for (auto i = 0; i < numberOfMatches; i++) {
-                    gameBoardChange.gameBoardChange[{i, column}] = {{i-numberOfMatches, column}, randomCell()};
+        auto removedCellsInColumn = matchedCells & CandyCrushBitboard::columnMask(column);
+        if (removedCellsInColumn == 0) {
+            continue;
+        }
+        
+        // Walk the column bottom up and move every remaining cell to the lowest free row
+        int newRow = (int)gameBoard.rows - 1;
+        for (int row = newRow; row >= 0; row--) {
+            GameBoard::CellPosition cellPosition = {row, column};
+            if ((removedCellsInColumn & CandyCrushBitboard::cellMask(cellPosition)) == 0) {
+                if (newRow != row) {
+                    gameBoardChange.movedCells.push_back({{newRow, column}, cellPosition, gameBoard[cellPosition]});
                 }
+                newRow--;
             }
-            
-            if (!cellsMatched) {
-                numberOfMatches = 1;
-            }
-            lastCell = gameBoard[row][column];
+        }
+        
+        // Add new cells at the top and say that they will come from above the board
+        int numberOfNewCells = newRow + 1;
+        for (auto row = 0; row < numberOfNewCells; row++) {
+            auto cell = randomCell();
+            bitboard.setCell({row, column}, cell);
+            gameBoardChange.movedCells.push_back({{row, column}, {row-numberOfNewCells, column}, cell});
         }
     }
     
-    // Apply all changes to the actual game board now
-    for (auto row = 0; row < gameBoard.rows; row++) {
-        for (auto column = 0; column < gameBoard.columns; column++) {
-            gameBoard[row][column] = gameBoardChange.gameBoardChange[{row, column}].second;
-        }
+    // Apply all changes to the actual game board now.
+    // The records hold the types from before any of them were applied, so the order they are applied in does not matter.
+    for (const auto& movedCell: gameBoardChange.movedCells) {
+        gameBoard.setCell(movedCell.to(), movedCell.cell());
     }
     
     // Let the caller see game board after changes
-    if (callback != nullptr) {
+    if (hasCallback(callback)) {
         callback(gameBoardChange);
     }
+}
+
+// The board never has any matches between moves, so a swap is legal exactly when one of the swapped cells ends up in a match
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+bool CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::isLegalMove(GameBoard::CellSwapMove move) const {
+    return gameBoard.swapCreatesMatch(move);
+}
+
+// The whole index is rebuilt from the bitboard with a few shifts per cell type, which is cheaper than checking the swaps
+// around the changed cells one at a time. Only the last rebuild in a move counts, and after it the board has no matches.
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+void CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::updateLegalMoves() {
+    TRACE_SPAN("updateLegalMoves");
+    bitboard.swapsCreatingMatch(legalRightSwaps, legalDownSwaps);
+}
+
+// Could have a more advanced score function where many matches are much more rewarded
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+int CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::scoreForMatches(int numberOfMatches) const {
+    return numberOfMatches;
+}
+
+// Performs the move and clears the matches it creates, but not the cascades that follow. Returns whether the move was valid.
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+template<typename Callback>
+bool CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::performMove(GameBoard::CellSwapMove move, const Callback& callback) {
+    TRACE_SPAN("performMove");
+    if (!gameBoard.areCellsAdjacent(move.from, move.to)) {
+        return false;
+    }
     
-    if (oldScore == score) {
-        
-        // If the move did not increase the score, it's not valid and the swap must be undone!
-        gameBoardChange.gameBoardChange[move.from] = {move.to, gameBoard[move.to]};
-        gameBoardChange.gameBoardChange[move.to] = {move.from, gameBoard[move.from]};
+    // Move pieces
+    gameBoard.swapCells(move);
+    bitboard.swapCells(move);
+    
+    // This allows the caller to see the game board changes done so far, which currently is just a swap
+    if (hasCallback(callback)) {
+        GameBoardChange gameBoardChange;
+        gameBoardChange.movedCells.push_back({move.from, move.to, gameBoard[move.from]});
+        gameBoardChange.movedCells.push_back({move.to, move.from, gameBoard[move.to]});
+        callback(gameBoardChange);
+    }
+    
+    // Every cell that is part of a horizontal or vertical match is found at once by shifting and ANDing the mask of each cell type
+    const auto matchedCells = bitboard.matchedCells();
+    if (matchedCells == 0) {
         
-        // Let the caller see the swap back
-        if (callback != nullptr) {
+        // A move that does not create a match is not valid and the swap must be undone!
+        if (hasCallback(callback)) {
+            GameBoardChange gameBoardChange;
+            gameBoardChange.movedCells.push_back({move.from, move.to, gameBoard[move.to]});
+            gameBoardChange.movedCells.push_back({move.to, move.from, gameBoard[move.from]});
             callback(gameBoardChange);
         }
         gameBoard.swapCells(move);
+        bitboard.swapCells(move);
         return false;
     }
-    return true;
+    clearMatches(matchedCells, callback);
     
+    boardGeneration++;
+    updateLegalMoves();
+    return true;
+}
+
+// A rejected move clears no waves, so it is not charged for the cascades of the move before it
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+bool CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::resolveMove(GameBoard::CellSwapMove move) {
+    cascadeWavesInLastMove.clear();
+    auto isMoveValid = performMove(move, NoCallback());
+    numberOfCascadesInLastMove = isMoveValid ? clearAllMatches(NoCallback()) : 0;
+    advanceVirtualClock(isMoveValid);
+    return isMoveValid;
 }
 
-// Return the game state that will occur after a move has been made
-CandyCrush CandyCrush::gameForMove(GameBoard::CellSwapMove move) const {
+// Return the game state that will occur after a move has been made. The cascades are cleared as well, since a board that
+// still has matches on it is not one the game can be in between moves.
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+CandyCrushGame<ROWS, COLUMNS, CELL_TYPES> CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::gameForMove(GameBoard::CellSwapMove move) const {
     auto gameCopy = *this;
-    gameCopy.performMove(move);
+    gameCopy.resolveMove(move);
     return gameCopy;
 }
 
-CandyCrush::CandyCrush() {
-    // The randomized board may have matching cells already – must be removed!
-    clearAllMatches();
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+CandyCrushGame<ROWS, COLUMNS, CELL_TYPES> CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::outcomeForMove(GameBoard::CellSwapMove move, uint64_t seed) const {
+    auto gameCopy = *this;
+    gameCopy.randomGenerator = RandomGenerator(seed);
+    gameCopy.resolveMove(move);
+    return gameCopy;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+uint64_t CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::randomSeed() {
+    return ((uint64_t)std::random_device()() << 32) | std::random_device()();
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::CandyCrushGame(): CandyCrushGame(randomSeed()) {}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::CandyCrushGame(uint64_t seed, Clock clock): seed(seed), randomGenerator(seed), clock(clock) {
+    if (!clock.isVirtual) {
+        startTime = std::chrono::high_resolution_clock::now();
+    }
+    
+    // The randomized board may have matching cells already – must be removed! Clearing them rebuilds the legal move index,
+    // a board without any has to build it here.
+    if (clearAllMatches(NoCallback()) == 0) {
+        updateLegalMoves();
+    }
     score = 0;
+    cascadeWavesInLastMove.clear();
+}
+
+// The cells are read from the bit planes directly, so unpacking never draws from the generator
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::CandyCrushGame(const PackedState& state): seed(state.seed), randomGenerator(state.randomGenerator), gameBoard([&](auto row, auto column) {
+    auto bit = row*CandyCrushGameBoard::columns + column;
+    size_t cellType = 0;
+    for (size_t i = 0; i < PackedState::numberOfCellTypeBits; i++) {
+        cellType |= (size_t)((state.cellTypeBits[i] >> bit) & 1) << i;
+    }
+    return (Cell)cellType;
+}), score(state.score), clock(Clock::virtualClock(0)) {
+    updateLegalMoves();
+}
+
+// Bit plane k is the union of the masks of the cell types that have bit k set
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+typename CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::PackedState CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::pack() const {
+    PackedState state(randomGenerator);
+    for (size_t i = 0; i < PackedState::numberOfCellTypeBits; i++) {
+        state.cellTypeBits[i] = 0;
+        for (size_t cellType = 0; cellType < numberOfCellTypes; cellType++) {
+            if ((cellType >> i) & 1) {
+                state.cellTypeBits[i] |= bitboard[cellType];
+            }
+        }
+    }
+    state.seed = seed;
+    state.score = score;
+    return state;
 }
 
-const CandyCrush::CandyCrushGameBoard& CandyCrush::getGameBoard() const {
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+const typename CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::CandyCrushGameBoard& CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getGameBoard() const {
     return gameBoard;
 }
 
-bool CandyCrush::operator==(const CandyCrush & game) const {
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+bool CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::operator==(const CandyCrushGame & game) const {
     return gameBoard == game.gameBoard;
 }
 
-int CandyCrush::getScore() const {
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+int CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getScore() const {
     return score;
 }
 
-bool CandyCrush::play(GameBoard::CellSwapMove move, GameBoardChangeCallback callback) {
-    if (!gameOver()) {
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+bool CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::play(GameBoard::CellSwapMove move, GameBoardChangeCallback callback) {
+    TRACE_SPAN("play");
+    
+    // The same as !gameOver(), but the time is read once so that the time reported for the move is the one it was judged by
+    numberOfMillisecondsElapsedInLastMove = numberOfMillisecondsElapsed();
+    if (numberOfMillisecondsElapsedInLastMove < (long)timeLimitInSeconds*1000 && hasLegalMoves()) {
+        cascadeWavesInLastMove.clear();
+        
+        // Without a callback the std::function is never called or passed on
+        if (callback == nullptr) {
+            auto isMoveValid = performMove(move, NoCallback());
+            numberOfCascadesInLastMove = clearAllMatches(NoCallback());
+            advanceVirtualClock(isMoveValid);
+            return isMoveValid;
+        }
         auto isMoveValid = performMove(move, callback);
-        clearAllMatches(callback);
+        numberOfCascadesInLastMove = clearAllMatches(callback);
+        advanceVirtualClock(isMoveValid);
         return isMoveValid;
     }
     return false;
 }
 
-bool CandyCrush::gameOver() const {
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+bool CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::gameOver() const {
     
     // Legal moves can theoretically be empty since new cells are completely randomly generated
-    return numberOfSecondsLeft() <= 0 || legalMoves().empty();
+    return numberOfSecondsLeft() <= 0 || !hasLegalMoves();
 }
 
-int CandyCrush::numberOfSecondsLeft() const {
+// The legal move index is kept up to date by every move, so this never has to look at the board
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+bool CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::hasLegalMoves() const {
+    return legalRightSwaps != 0 || legalDownSwaps != 0;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+int CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getNumberOfCascadesInLastMove() const {
+    return numberOfCascadesInLastMove;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+const typename CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::CascadeWaves& CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getCascadeWavesInLastMove() const {
+    return cascadeWavesInLastMove;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+uint64_t CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getSeed() const {
+    return seed;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+int CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getTimeLimitInSeconds() const {
+    return timeLimitInSeconds;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+unsigned long CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getBoardGeneration() const {
+    return boardGeneration;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+long CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getNumberOfMillisecondsElapsedInLastMove() const {
+    return numberOfMillisecondsElapsedInLastMove;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+const typename CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::Clock& CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::getClock() const {
+    return clock;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+long CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::numberOfMillisecondsElapsed() const {
+    if (clock.isVirtual) {
+        return virtualMillisecondsElapsed;
+    }
     auto currentTime = std::chrono::high_resolution_clock::now();
-    int numberOfSecondsElapsed = (int)std::chrono::duration_cast<std::chrono::seconds>(currentTime-startTime).count();
-    return numberOfSecondsElapsed < timeLimitInSeconds ? timeLimitInSeconds-numberOfSecondsElapsed : 0;
+    return (long)std::chrono::duration_cast<std::chrono::milliseconds>(currentTime-startTime).count();
+}
+
+// Rejected moves take the player time as well but clear no waves. An accepted move clears the wave of matches it created
+// in performMove before the cascades that clearAllMatches counts.
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+void CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::advanceVirtualClock(bool wasMoveAccepted) {
+    if (clock.isVirtual) {
+        auto numberOfWaves = wasMoveAccepted ? 1 + numberOfCascadesInLastMove : 0;
+        virtualMillisecondsElapsed += clock.millisecondsPerMove + clock.millisecondsPerWave*numberOfWaves;
+    }
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+int CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::numberOfSecondsLeft() const {
+    auto numberOfSecondsElapsed = numberOfMillisecondsElapsed() / 1000;
+    return numberOfSecondsElapsed < timeLimitInSeconds ? timeLimitInSeconds-(int)numberOfSecondsElapsed : 0;
+}
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+int CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::numberOfMillisecondsUntilNextSecond() const {
+    return (int)(1000 - numberOfMillisecondsElapsed() % 1000);
 }
 
-std::vector<GameBoard::CellSwapMove> CandyCrush::legalMoves() const {
+// Legal moves are read from the index, each legal swap is returned in both directions
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+std::vector<GameBoard::CellSwapMove> CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::legalMoves() const {
+    TRACE_SPAN("legalMoves");
     std::vector<GameBoard::CellSwapMove> moves;
+    auto isLegalSwap = [&](GameBoard::CellPosition cell, GameBoard::CellPosition adjacentCell) {
+        if (adjacentCell.row < cell.row || adjacentCell.column < cell.column) {
+            std::swap(cell, adjacentCell);
+        }
+        auto mask = adjacentCell.row == cell.row ? legalRightSwaps : legalDownSwaps;
+        return (mask & CandyCrushBitboard::cellMask(cell)) != 0;
+    };
     for (auto row = 0 ; row < gameBoard.rows; row++) {
         for (auto column = 0; column < gameBoard.columns; column++) {
             GameBoard::CellPosition cell(row, column);
             for (auto adjacentCell: gameBoard.adjacentCells(cell)) {
-                if (isLegalMove(GameBoard::CellSwapMove(cell, adjacentCell))) {
+                if (isLegalSwap(cell, adjacentCell)) {
                     moves.push_back(GameBoard::CellSwapMove(cell, adjacentCell));
                 }
             }
@@ -218,16 +391,20 @@ std::vector<GameBoard::CellSwapMove> CandyCrush::legalMoves() const {
     return moves;
 }
 
-std::ostream& operator<<(std::ostream& os, const CandyCrush& game) {
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+std::ostream& operator<<(std::ostream& os, const CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>& game) {
     os << "--------------------" << std::endl;
     os << "Score: " << game.getScore() << std::endl;
-    std::unordered_map<CandyCrush::Cell, std::string> cellString {
-        {CandyCrush::Green, "G"},
-        {CandyCrush::Blue, "B"},
-        {CandyCrush::Purple, "P"},
-        {CandyCrush::Yellow, "Y"},
-        {CandyCrush::Red, "R"},
-        //{CandyCrush::Purple, "!"}
+    typedef CandyCrushGame<ROWS, COLUMNS, CELL_TYPES> Game;
+    std::unordered_map<size_t, std::string> cellString {
+        {Game::Green, "G"},
+        {Game::Blue, "B"},
+        {Game::Purple, "P"},
+        {Game::Yellow, "Y"},
+        {Game::Red, "R"},
+        {Game::Orange, "O"},
+        {Game::White, "W"},
+        //{Game::Purple, "!"}
     };
     
     os << std::endl;
@@ -242,3 +419,27 @@ std::ostream& operator<<(std::ostream& os, const CandyCrush& game) {
     os << std::endl;
     return os;
 }
+
+// Every shape is instantiated here, the classic game is the 8x8 board with 5 cell types and the others are the shapes
+// BoardShapeGame supports
+template class CandyCrushGame<6, 6, 4>;
+template class CandyCrushGame<6, 6, 5>;
+template class CandyCrushGame<6, 6, 6>;
+template class CandyCrushGame<6, 6, 7>;
+template class CandyCrushGame<8, 8, 4>;
+template class CandyCrushGame<8, 8, 5>;
+template class CandyCrushGame<8, 8, 6>;
+template class CandyCrushGame<8, 8, 7>;
+template class CandyCrushGame<9, 9, 4>;
+template class CandyCrushGame<9, 9, 5>;
+template class CandyCrushGame<9, 9, 6>;
+template class CandyCrushGame<9, 9, 7>;
+template class CandyCrushGame<10, 10, 4>;
+template class CandyCrushGame<10, 10, 5>;
+template class CandyCrushGame<10, 10, 6>;
+template class CandyCrushGame<10, 10, 7>;
+
+// Instantiated here so that the benchmark can time single moves and cascades without a callback
+template bool CandyCrush::performMove(GameBoard::CellSwapMove move, const CandyCrush::NoCallback& callback);
+template int CandyCrush::clearAllMatches(const CandyCrush::NoCallback& callback);
+template std::ostream& operator<<(std::ostream& os, const CandyCrush& game);
@@ -6,60 +6,261 @@
 #include <unordered_set>
 #include <vector>
 #include "GameBoard.hpp"
+#include "Bitboard.hpp"
+#include "RandomGenerator.hpp"
 #include <chrono>
 
-struct CandyCrushGameBoardChange;
-
-class CandyCrush {
+// The game on a board of ROWS x COLUMNS cells with CELL_TYPES different cell types. The classic game is CandyCrush below,
+// BoardShapeGame plays the other shapes on the same engine. Boards of up to 128 cells are supported.
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+class CandyCrushGame {
+    
+    // The benchmark needs to time the private move and cascade steps on their own
+    friend struct CandyCrushBenchmark;
+    
+    // The tests clear matches on boards that are set up with matches on them
+    friend struct CandyCrushTests;
+    
 public:
-    enum Cell {Green, Blue, Purple, Red, Yellow};
-    typedef GameBoard::GameBoard<8, 8, CandyCrush::Cell> CandyCrushGameBoard;
-    typedef std::function<void(CandyCrushGameBoardChange)> GameBoardChangeCallback;
+    // One byte per cell keeps a copy of the classic game board at 64 bytes. Games with fewer cell types than colors listed here
+    // only use the first ones.
+    enum Cell: uint8_t {Green, Blue, Purple, Red, Yellow, Orange, White};
+    static const size_t numberOfCellTypes = CELL_TYPES;
+    static_assert(CELL_TYPES >= 3 && CELL_TYPES <= 7, "There are 7 colors and at least three are needed to avoid constant matches");
+    
+    // Increased whenever a change to the rules makes the same seed and moves play out differently, replays recorded with
+    // other rules can not be verified
+    static const uint16_t rulesVersion = 1;
+    typedef GameBoard::GameBoard<ROWS, COLUMNS, Cell, CELL_TYPES> CandyCrushGameBoard;
+    typedef GameBoard::Bitboard<ROWS, COLUMNS, CELL_TYPES> CandyCrushBitboard;
+    
+    // What happened to the game board in one step of a move, as a list of compact records for the cells that changed only.
+    // Cells that are not listed keep their place and type. The records are stored inline, so creating a change never allocates,
+    // and callbacks get it by reference so it is never copied.
+    struct GameBoardChange {
+        
+        // A cell that ended up at a new position, either moved there or new from above the board (the row it comes from is negative)
+        struct MovedCell {
+            int8_t toRow = 0;
+            int8_t toColumn = 0;
+            int8_t fromRow = 0;
+            int8_t fromColumn = 0;
+            uint8_t cellType = 0;
+            
+            MovedCell() {}
+            MovedCell(GameBoard::CellPosition to, GameBoard::CellPosition from, Cell cell): toRow((int8_t)to.row), toColumn((int8_t)to.column), fromRow((int8_t)from.row), fromColumn((int8_t)from.column), cellType((uint8_t)cell) {}
+            
+            GameBoard::CellPosition to() const {
+                return GameBoard::CellPosition(toRow, toColumn);
+            }
+            
+            GameBoard::CellPosition from() const {
+                return GameBoard::CellPosition(fromRow, fromColumn);
+            }
+            
+            Cell cell() const {
+                return (Cell)cellType;
+            }
+        };
+        
+        // A cell that was part of a match and is gone from the board
+        struct RemovedCell {
+            int8_t row = 0;
+            int8_t column = 0;
+            uint8_t cellType = 0;
+            
+            RemovedCell() {}
+            RemovedCell(GameBoard::CellPosition position, Cell cell): row((int8_t)position.row), column((int8_t)position.column), cellType((uint8_t)cell) {}
+            
+            GameBoard::CellPosition position() const {
+                return GameBoard::CellPosition(row, column);
+            }
+            
+            Cell cell() const {
+                return (Cell)cellType;
+            }
+        };
+        
+        // Every position is listed at most once in each list
+        GameBoard::FixedCapacityVector<MovedCell, ROWS*COLUMNS> movedCells;
+        GameBoard::FixedCapacityVector<RemovedCell, ROWS*COLUMNS> removedCells;
+    };
+    
+    typedef std::function<void(const GameBoardChange&)> GameBoardChangeCallback;
+    
+    // What one wave of clearing matches removed. The matches created by a move are the first wave of the move and every
+    // cascade after it is another wave.
+    struct CascadeWave {
+        uint8_t numberOfRemovedCells = 0;
+        uint8_t numberOfRuns = 0;
+        uint16_t score = 0;
+    };
+    
+    // Longer cascades are very rare, their later waves are counted but not reported
+    static const size_t maximumNumberOfReportedWaves = 8;
+    typedef GameBoard::FixedCapacityVector<CascadeWave, maximumNumberOfReportedWaves> CascadeWaves;
+    
+    // Where a game gets its time from. Games on the wall clock run out of time when their time limit has passed since they were
+    // created, like the game in the window. A virtual clock never reads the time, instead every move made with play or
+    // outcomeForMove moves it forward by the time a player is assumed to take for the move. Simulations on a virtual clock play
+    // the time limited mode like a player would, as fast as the moves can be made.
+    struct Clock {
+        bool isVirtual = false;
+        
+        // Time a virtual clock moves forward for every move and for every wave of matches it clears, since the player waits for
+        // the animations of the waves before making the next move. An accepted move clears its first wave and every cascade
+        // after it, a rejected move clears none. testVirtualClockChargesEveryWave in Tests.cpp checks both for play and
+        // outcomeForMove.
+        int millisecondsPerMove = 0;
+        int millisecondsPerWave = 0;
+        
+        static Clock wallClock() {
+            return Clock();
+        }
+        
+        static Clock virtualClock(int millisecondsPerMove, int millisecondsPerWave = 0) {
+            Clock clock;
+            clock.isVirtual = true;
+            clock.millisecondsPerMove = millisecondsPerMove;
+            clock.millisecondsPerWave = millisecondsPerWave;
+            return clock;
+        }
+    };
+    
+    // Everything a search needs to continue playing from a position, in 72 bytes for the classic game instead of the few hundred
+    // bytes of a game.
+    // The cells are stored as three bit planes, bit k of the cell type of every cell is in cellTypeBits[k], which gives 3 bits
+    // per cell. The new cells keep coming from the same generator, so unpacking a state gives a game that plays on exactly
+    // like the one it was packed from. The clock is not part of the state, unpacked games are on a virtual clock that stands still.
+    struct PackedState {
+        static const size_t numberOfCellTypeBits = 3;
+        typename CandyCrushBitboard::Mask cellTypeBits[numberOfCellTypeBits];
+        RandomGenerator randomGenerator;
+        uint64_t seed;
+        int score;
+        
+        PackedState(const RandomGenerator& randomGenerator): randomGenerator(randomGenerator) {}
+    };
+    static_assert(numberOfCellTypes <= (1 << PackedState::numberOfCellTypeBits), "Every cell type must fit in the bits of a packed state");
     
 private:
+    // Every game draws its cells from its own generator seeded with the seed of the game, it must be declared before the game
+    // board that uses it
+    uint64_t seed;
+    RandomGenerator randomGenerator;
+    
     // Creates randomized game board
-    CandyCrushGameBoard gameBoard = CandyCrushGameBoard([](auto rows, auto columns) {
-        std::vector<CandyCrush::Cell> cells = {Green, Blue, Purple, Red, Yellow};
-        return cells[rand() % cells.size()];
+    CandyCrushGameBoard gameBoard = CandyCrushGameBoard([this](auto rows, auto columns) {
+        return randomCell();
     });
     
+    // Same board as above with one mask per cell type, kept in sync with the game board and used for finding matches
+    CandyCrushBitboard bitboard = CandyCrushBitboard(gameBoard);
+    
+    // Index of legal moves, a bit is set if swapping the cell with the cell to the right (or below) creates a match
+    typename CandyCrushBitboard::Mask legalRightSwaps = 0;
+    typename CandyCrushBitboard::Mask legalDownSwaps = 0;
+    void updateLegalMoves();
+    
+    // Increased every time the game board changes so that callers can tell whether anything derived from it is still valid
+    unsigned long boardGeneration = 0;
+    
     int timeLimitInSeconds = 60;
     int score = 0;
     Cell randomCell();
-    void clearAllMatches(GameBoardChangeCallback callback = nullptr);
-    std::chrono::time_point<std::chrono::high_resolution_clock> startTime = std::chrono::high_resolution_clock::now();
+    
+    // Used instead of an empty std::function so that moves without a callback skip everything that is only done for the caller
+    struct NoCallback {
+        void operator()(const GameBoardChange&) const {}
+    };
+    static bool hasCallback(const NoCallback&) { return false; }
+    static bool hasCallback(const GameBoardChangeCallback& callback) { return callback != nullptr; }
+    
+    template<typename Callback>
+    int clearAllMatches(const Callback& callback);
+    
+    // Clears the given matched cells and refills the board, which may create new matches
+    template<typename Callback>
+    void clearMatches(typename CandyCrushBitboard::Mask matchedCells, const Callback& callback);
+    int numberOfCascadesInLastMove = 0;
+    CascadeWaves cascadeWavesInLastMove;
+    
+    // Only the clock in use is kept up to date, a game on a virtual clock never reads the time
+    Clock clock;
+    std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
+    long virtualMillisecondsElapsed = 0;
+    long numberOfMillisecondsElapsedInLastMove = 0;
+    long numberOfMillisecondsElapsed() const;
+    void advanceVirtualClock(bool wasMoveAccepted);
     
     int scoreForMatches(int numberOfMatches) const;
-    bool performMove(GameBoard::CellSwapMove move, GameBoardChangeCallback callback = nullptr);
+    template<typename Callback>
+    bool performMove(GameBoard::CellSwapMove move, const Callback& callback);
+    
+    // Plays the move and its cascades without a callback and without looking at the time limit, returns whether it was valid
+    bool resolveMove(GameBoard::CellSwapMove move);
 public:
-    CandyCrush();
+    CandyCrushGame();
+    
+    // Games created with the same seed have the same board and get the same new cells for the same moves
+    CandyCrushGame(uint64_t seed, Clock clock = Clock::wallClock());
+    
+    // Unpacks a game from a packed state, it has the whole time limit left
+    explicit CandyCrushGame(const PackedState& state);
+    PackedState pack() const;
+    
+    // Seed for a game that is different every time, used by the constructor without a seed
+    static uint64_t randomSeed();
     const CandyCrushGameBoard& getGameBoard() const;
-    CandyCrush gameForMove(GameBoard::CellSwapMove) const;
+    
+    // Plays the move including all cascades on a copy of the game, with the new cells this game would get. This is the game
+    // that play leaves behind, so it knows which cells come next. Players that must not know them use outcomeForMove.
+    CandyCrushGame gameForMove(GameBoard::CellSwapMove) const;
+    
+    // Plays the move including all cascades on a copy of the game. The new cells are drawn from a generator with the given seed,
+    // so different seeds give the different possible outcomes of the same move. Moves compared with the same seed are
+    // compared on equal terms.
+    CandyCrushGame outcomeForMove(GameBoard::CellSwapMove move, uint64_t seed) const;
     bool isLegalMove(GameBoard::CellSwapMove move) const;
-    bool operator==(const CandyCrush & game) const;
+    bool operator==(const CandyCrushGame & game) const;
     int getScore() const;
     int numberOfSecondsLeft() const;
+    
+    // Time until numberOfSecondsLeft changes, so that a user interface can sleep until the timer needs to be redrawn
+    int numberOfMillisecondsUntilNextSecond() const;
     bool play(GameBoard::CellSwapMove move, GameBoardChangeCallback callback = nullptr);
     bool gameOver() const;
+    bool hasLegalMoves() const;
+    unsigned long getBoardGeneration() const;
+    int getNumberOfCascadesInLastMove() const;
+    const CascadeWaves& getCascadeWavesInLastMove() const;
+    
+    // Time on the clock of the game when the last move was played, which decided whether the move was in time
+    long getNumberOfMillisecondsElapsedInLastMove() const;
+    
+    // The seed the game was created with, copies made for other outcomes of a move keep it
+    uint64_t getSeed() const;
+    int getTimeLimitInSeconds() const;
+    const Clock& getClock() const;
     std::vector<GameBoard::CellSwapMove> legalMoves() const;
 };
 
 
-struct CandyCrushGameBoardChange {
-    std::unordered_map<GameBoard::CellPosition, std::pair<GameBoard::CellPosition, CandyCrush::Cell>> gameBoardChange;
-    std::vector<std::pair<GameBoard::CellPosition, CandyCrush::Cell>> removedCells;
-    
-    // This initializes a game board change where nothing has been removed and all cells map to themselves, thus indicating that no changes has been done
-    CandyCrushGameBoardChange(CandyCrush game) {
-        for (auto row = 0; row < game.getGameBoard().rows; row++) {
-            for (auto column = 0; column < game.getGameBoard().columns; column++) {
-                gameBoardChange[GameBoard::CellPosition(row, column)] = {GameBoard::CellPosition(row, column), game.getGameBoard()[GameBoard::CellPosition(row, column)]};
-            }
-        }
-    }
-};
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+const size_t CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::numberOfCellTypes;
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+const uint16_t CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::rulesVersion;
+
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+const size_t CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>::maximumNumberOfReportedWaves;
+
+// The members are defined in CandyCrush.cpp, which instantiates the classic game and every shape BoardShapeGame supports
+typedef CandyCrushGame<8, 8, 5> CandyCrush;
+typedef CandyCrush::GameBoardChange CandyCrushGameBoardChange;
 
-std::ostream& operator<<(std::ostream& os, const CandyCrush& game);
+template<size_t ROWS, size_t COLUMNS, size_t CELL_TYPES>
+std::ostream& operator<<(std::ostream& os, const CandyCrushGame<ROWS, COLUMNS, CELL_TYPES>& game);
 
 #endif /* CandyCrush_hpp */
 
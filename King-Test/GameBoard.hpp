@@ -2,6 +2,12 @@
 #define GameBoard_hpp
 
 #include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <utility>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -15,8 +21,8 @@ namespace GameBoard {
         int row = 0;
         int column = 0;
         
-        CellPosition(int row, int column): row(row), column(column) {}
-        CellPosition() {}
+        constexpr CellPosition(int row, int column): row(row), column(column) {}
+        constexpr CellPosition() {}
         
         CellPosition cellAtDirection(Direction direction) {
             switch (direction) {
@@ -43,16 +49,116 @@ namespace GameBoard {
     
     std::ostream& operator<<(std::ostream& os, const CellSwapMove& move);
     
-    template<size_t ROWS, size_t COLUMNS, typename CellType>
+    // Vector that keeps room for at most CAPACITY elements inside itself, so adding elements never allocates.
+    // Callers must make sure that it never gets more than CAPACITY elements.
+    template<typename T, size_t CAPACITY>
+    class FixedCapacityVector {
+    private:
+        T elements[CAPACITY] = {};
+        size_t count = 0;
+    public:
+        constexpr void push_back(const T& element) {
+            assert(count < CAPACITY);
+            elements[count++] = element;
+        }
+        
+        void clear() {
+            count = 0;
+        }
+        
+        size_t size() const {
+            return count;
+        }
+        
+        bool empty() const {
+            return count == 0;
+        }
+        
+        T& operator[](const size_t index) {
+            return elements[index];
+        }
+        
+        const T& operator[](const size_t index) const {
+            return elements[index];
+        }
+        
+        T* begin() {
+            return elements;
+        }
+        
+        T* end() {
+            return elements + count;
+        }
+        
+        const T* begin() const {
+            return elements;
+        }
+        
+        const T* end() const {
+            return elements + count;
+        }
+    };
+    
+    // Cells hold one of CELL_TYPES cell types numbered from zero
+    template<size_t ROWS, size_t COLUMNS, typename CellType, size_t CELL_TYPES>
     class GameBoard {
     private:
         CellType gameBoard[ROWS][COLUMNS];
+        
+        // Zobrist hash of the board, the XOR of the keys of all cells. Cells are only written through swapCells and setCell,
+        // which update it for the changed cells, and performActionOnCell, which recomputes it.
+        uint64_t hash = 0;
+        
+        // Every cell type has a key of its own for every cell, keys of the same type are next to each other
+        struct ZobristTable {
+            uint64_t keys[CELL_TYPES][ROWS*COLUMNS];
+        };
+        
+        // Random keys from a splitmix64 sequence with a fixed seed, so hashes are the same in every run and on every thread
+        static constexpr ZobristTable makeZobristTable() {
+            ZobristTable table = {};
+            uint64_t state = 0x5eed2b0a2d5eed5e;
+            for (size_t value = 0; value < CELL_TYPES; value++) {
+                for (size_t cell = 0; cell < ROWS*COLUMNS; cell++) {
+                    state += 0x9e3779b97f4a7c15;
+                    uint64_t key = state;
+                    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9;
+                    key = (key ^ (key >> 27)) * 0x94d049bb133111eb;
+                    table.keys[value][cell] = key ^ (key >> 31);
+                }
+            }
+            return table;
+        }
+        
+        static constexpr ZobristTable zobristTable = makeZobristTable();
+        
+        static uint64_t zobristKey(const CellPosition cell, const CellType value) {
+            return zobristTable.keys[(size_t)value][cell.row*COLUMNS + cell.column];
+        }
+        
+        void recomputeHash() {
+            hash = 0;
+            for (size_t row = 0; row < ROWS; row++) {
+                for (size_t column = 0; column < COLUMNS; column++) {
+                    hash ^= zobristKey(CellPosition((int)row, (int)column), gameBoard[row][column]);
+                }
+            }
+        }
     public:
         
-        size_t rows = ROWS;
-        size_t columns = COLUMNS;
+        // The size is part of the type so that every loop over the board has compile time bounds
+        static constexpr size_t rows = ROWS;
+        static constexpr size_t columns = COLUMNS;
+        static constexpr size_t numberOfCellTypes = CELL_TYPES;
+        
+        // Every cell holds the first cell type, for boards that will be filled in by the caller
+        GameBoard(): gameBoard() {
+            recomputeHash();
+        }
         
-        GameBoard(const std::function<CellType(size_t, size_t)> defaultValueForCell) {
+        // Takes any callable returning the value for a (row, column), it is only enabled for callables so copies still use the copy constructor
+        template<typename DefaultValueForCell, typename = decltype(std::declval<DefaultValueForCell>()(size_t(), size_t()))>
+        GameBoard(const DefaultValueForCell defaultValueForCell) {
             performActionOnCell([&](auto row, auto column, auto& cell) {
                 cell = defaultValueForCell(row, column);
             });
@@ -65,20 +171,22 @@ namespace GameBoard {
             });
         }
         
-        CellType* operator[](const size_t index) {
-            return gameBoard[index];
+        uint64_t getHash() const {
+            return hash;
         }
         
+        // Changes a single cell and updates the hash with the keys of the old and new value
+        void setCell(const CellPosition cell, const CellType value) {
+            auto& oldValue = gameBoard[cell.row][cell.column];
+            hash ^= zobristKey(cell, oldValue) ^ zobristKey(cell, value);
+            oldValue = value;
+        }
         
+        // Cells are read only through the subscript operators, so every write goes through a method that keeps the hash
         const CellType* operator[](const size_t index) const {
             return gameBoard[index];
         }
         
-        
-        CellType& operator[](const CellPosition cell) {
-            return gameBoard[cell.row][cell.column];
-        }
-        
         const CellType& operator[](const CellPosition cell) const {
             return gameBoard[cell.row][cell.column];
         }
@@ -88,46 +196,52 @@ namespace GameBoard {
         }
         
         void swapCells(const CellPosition firstCell, const CellPosition secondCell) {
-            std::swap((*this)[firstCell], (*this)[secondCell]);
+            auto& firstValue = gameBoard[firstCell.row][firstCell.column];
+            auto& secondValue = gameBoard[secondCell.row][secondCell.column];
+            hash ^= zobristKey(firstCell, firstValue) ^ zobristKey(secondCell, secondValue) ^ zobristKey(firstCell, secondValue) ^ zobristKey(secondCell, firstValue);
+            std::swap(firstValue, secondValue);
         }
         
         bool isCellValid(CellPosition cell) const {
-            return cell.row >= 0 && cell.row < rows && cell.column >= 0 && cell.column < columns;
+            return cell.row >= 0 && (size_t)cell.row < rows && cell.column >= 0 && (size_t)cell.column < columns;
         }
         
         bool areCellsAdjacent(CellPosition cell1, CellPosition cell2) const {
-            if (!isCellValid(cell1)) {
+            if (!isCellValid(cell1) || !isCellValid(cell2)) {
                 return false;
             }
-            auto cells = adjacentCells(cell1);
-            return std::find(cells.begin(), cells.end(), cell2) != cells.end();
+            return std::abs(cell1.row - cell2.row) + std::abs(cell1.column - cell2.column) == 1;
         }
         
-        std::vector<CellPosition> adjacentCells(CellPosition cell) const {
-            std::vector<CellPosition> cells;
-            for (auto direction: {Up, Right, Down, Left}) {
-                auto adjacentCell = cell.cellAtDirection(direction);
-                if (isCellValid(adjacentCell)) {
-                    cells.push_back(adjacentCell);
-                }
+        // Whether swapping the cells would put one of them in 3 or more consecutive equal cells on its row or column.
+        // Only looks at the cells at most two steps away from the swapped cells and leaves the board untouched.
+        bool swapCreatesMatch(const CellSwapMove move) const {
+            if (!areCellsAdjacent(move.from, move.to)) {
+                return false;
             }
-            return cells;
+            return cellCreatesMatch(move.to, (*this)[move.from], move) || cellCreatesMatch(move.from, (*this)[move.to], move);
+        }
+        
+        // Adjacent cells in the order up, right, down, left, copied from a table built at compile time
+        FixedCapacityVector<CellPosition, 4> adjacentCells(CellPosition cell) const {
+            return neighbourTable.adjacentCells[cell.row*COLUMNS + cell.column];
         }
         
-        void performActionOnCell(const std::function<void(size_t, size_t, CellType&)> action) {
-            for (auto rowIndex = 0; rowIndex < rows; rowIndex++) {
-                for (auto columnIndex = 0; columnIndex < columns; columnIndex++) {
-                    action(rowIndex, columnIndex, (*this)[rowIndex][columnIndex]);
+        // The action may change any cell, the hash is recomputed once all cells have been visited
+        template<typename Action>
+        void performActionOnCell(const Action action) {
+            for (size_t rowIndex = 0; rowIndex < ROWS; rowIndex++) {
+                for (size_t columnIndex = 0; columnIndex < COLUMNS; columnIndex++) {
+                    action(rowIndex, columnIndex, gameBoard[rowIndex][columnIndex]);
                 }
             }
+            recomputeHash();
         }
         
+        // Boards of different sizes have different types, so only the cells need to be compared
         bool operator==(const GameBoard & gameBoard) const {
-            if (rows != gameBoard.rows || columns != gameBoard.columns) {
-                return false;
-            }
-            for (auto i = 0; i < rows; i++) {
-                for (auto j = 0; j < columns; j++) {
+            for (size_t i = 0; i < rows; i++) {
+                for (size_t j = 0; j < columns; j++) {
                     if ((*this)[i][j] != gameBoard[i][j]) {
                         return false;
                     }
@@ -135,7 +249,74 @@ namespace GameBoard {
             }
             return true;
         }
+        
+    private:
+        
+        struct NeighbourTable {
+            FixedCapacityVector<CellPosition, 4> adjacentCells[ROWS*COLUMNS];
+        };
+        
+        static constexpr NeighbourTable makeNeighbourTable() {
+            NeighbourTable table = {};
+            const int rowSteps[] = {-1, 0, 1, 0};
+            const int columnSteps[] = {0, 1, 0, -1};
+            for (int row = 0; row < (int)ROWS; row++) {
+                for (int column = 0; column < (int)COLUMNS; column++) {
+                    for (int direction = 0; direction < 4; direction++) {
+                        auto adjacentRow = row + rowSteps[direction];
+                        auto adjacentColumn = column + columnSteps[direction];
+                        if (adjacentRow >= 0 && adjacentRow < (int)ROWS && adjacentColumn >= 0 && adjacentColumn < (int)COLUMNS) {
+                            table.adjacentCells[row*COLUMNS + column].push_back(CellPosition(adjacentRow, adjacentColumn));
+                        }
+                    }
+                }
+            }
+            return table;
+        }
+        
+        static constexpr NeighbourTable neighbourTable = makeNeighbourTable();
+        
+        // The value the cell would have after the move
+        const CellType& cellAfterSwap(const CellPosition cell, const CellSwapMove move) const {
+            if (cell == move.from) {
+                return (*this)[move.to];
+            }
+            if (cell == move.to) {
+                return (*this)[move.from];
+            }
+            return (*this)[cell];
+        }
+        
+        bool cellCreatesMatch(const CellPosition cell, const CellType& value, const CellSwapMove move) const {
+            
+            // Counts up to two equal cells next to the cell in one direction
+            auto numberOfEqualCells = [&](int rowStep, int columnStep) {
+                auto numberOfCells = 0;
+                auto nextCell = CellPosition(cell.row+rowStep, cell.column+columnStep);
+                while (numberOfCells < 2 && isCellValid(nextCell) && cellAfterSwap(nextCell, move) == value) {
+                    numberOfCells++;
+                    nextCell = CellPosition(nextCell.row+rowStep, nextCell.column+columnStep);
+                }
+                return numberOfCells;
+            };
+            return numberOfEqualCells(0, -1) + numberOfEqualCells(0, 1) >= 2 || numberOfEqualCells(-1, 0) + numberOfEqualCells(1, 0) >= 2;
+        }
     };
+    
+    template<size_t ROWS, size_t COLUMNS, typename CellType, size_t CELL_TYPES>
+    constexpr size_t GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>::rows;
+    
+    template<size_t ROWS, size_t COLUMNS, typename CellType, size_t CELL_TYPES>
+    constexpr size_t GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>::columns;
+    
+    template<size_t ROWS, size_t COLUMNS, typename CellType, size_t CELL_TYPES>
+    constexpr size_t GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>::numberOfCellTypes;
+    
+    template<size_t ROWS, size_t COLUMNS, typename CellType, size_t CELL_TYPES>
+    constexpr typename GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>::NeighbourTable GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>::neighbourTable;
+    
+    template<size_t ROWS, size_t COLUMNS, typename CellType, size_t CELL_TYPES>
+    constexpr typename GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>::ZobristTable GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>::zobristTable;
 }
 
 namespace std {
@@ -153,6 +334,16 @@ namespace std {
             return seed;
         }
     };
+    
+    // Boards are hashed in constant time since the Zobrist hash is kept up to date as cells change
+    template <size_t ROWS, size_t COLUMNS, typename CellType, size_t CELL_TYPES>
+    struct hash<GameBoard::GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>>
+    {
+        std::size_t operator()(const GameBoard::GameBoard<ROWS, COLUMNS, CellType, CELL_TYPES>& gameBoard) const
+        {
+            return (std::size_t)gameBoard.getHash();
+        }
+    };
 }
 
 #endif /* GameBoard_hpp */
@@ -0,0 +1,119 @@
+#include "GameThread.hpp"
+#include <chrono>
+#include "Trace.hpp"
+
+GameThread::GameThread(std::function<void()> onPublish, std::string replayPath): onPublish(onPublish), replayPath(replayPath) {
+    publishSnapshot();
+    thread = std::thread([this] {
+        run();
+    });
+}
+
+GameThread::~GameThread() {
+    {
+        std::lock_guard<std::mutex> lock(wakeUpMutex);
+        isStopping = true;
+    }
+    wakeUp.notify_one();
+    thread.join();
+}
+
+void GameThread::startNewGame(uint64_t seed, CandyCrush::Clock clock) {
+    Command command;
+    command.type = Command::NewGame;
+    command.seed = seed;
+    command.clock = clock;
+    send(command);
+}
+
+void GameThread::play(GameBoard::CellSwapMove move) {
+    Command command;
+    command.type = Command::Move;
+    command.move = move;
+    send(command);
+}
+
+void GameThread::saveReplay() {
+    Command command;
+    command.type = Command::SaveReplay;
+    send(command);
+}
+
+// The game thread handles commands far faster than a player makes them, so the queue is only full if it is stuck
+void GameThread::send(const Command& command) {
+    while (!commands.push(command)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    numberOfCommandsSent++;
+
+    // Taking the mutex makes sure that the game thread is either before its check for commands or already waiting
+    {
+        std::lock_guard<std::mutex> lock(wakeUpMutex);
+    }
+    wakeUp.notify_one();
+}
+
+void GameThread::run() {
+    Trace::setThreadName("Game");
+    Command command;
+    while (!isStopping) {
+        if (commands.pop(command)) {
+            handle(command);
+            numberOfCommandsHandled++;
+            publishSnapshot();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeUpMutex);
+        wakeUp.wait(lock, [this] {
+            return isStopping || !commands.empty();
+        });
+    }
+}
+
+void GameThread::handle(const Command& command) {
+    TRACE_SPAN("handleCommand");
+    switch (command.type) {
+        case Command::NewGame:
+            game = CandyCrush(command.seed, command.clock);
+            replayWriter = Replay::Writer(game);
+            break;
+        case Command::Move: {
+            auto wasAccepted = game.play(command.move, [this](const CandyCrushGameBoardChange& gameBoardChange) {
+                TRACE_SPAN("queueBoardStep");
+                BoardStep boardStep;
+                boardStep.gameBoard = game.getGameBoard();
+                boardStep.gameBoardChange = gameBoardChange;
+                boardStep.score = game.getScore();
+
+                // The user interface takes the steps when it wakes up, so it is woken up while the queue is full. When the game
+                // thread is stopped nobody takes them any more and the remaining steps of the move are dropped.
+                while (!boardSteps.push(boardStep)) {
+                    if (isStopping) {
+                        return;
+                    }
+                    if (onPublish) {
+                        onPublish();
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+            replayWriter.recordMove(game, command.move, wasAccepted);
+            break;
+        }
+        case Command::SaveReplay:
+            if (!replayPath.empty()) {
+                replayWriter.save(replayPath);
+            }
+            break;
+    }
+}
+
+void GameThread::publishSnapshot() {
+    auto& snapshot = snapshots.backBuffer();
+    snapshot.game = game;
+    snapshot.numberOfCommands = numberOfCommandsHandled;
+    snapshots.publish();
+    if (onPublish) {
+        onPublish();
+    }
+}
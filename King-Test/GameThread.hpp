@@ -0,0 +1,111 @@
+#ifndef GameThread_hpp
+#define GameThread_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "CandyCrush.hpp"
+#include "LockFreeQueue.hpp"
+#include "Replay.hpp"
+#include "TripleBuffer.hpp"
+
+// Plays the game on its own thread, so that checking moves and clearing cascades never delay the frames of a user interface.
+//
+// The user interface sends moves and new games through a lock free queue. After every command the game thread publishes a
+// copy of the game through a triple buffer, which the user interface reads with const methods only. The board changes of
+// every step of a move are needed for the animations, so they are not left to the snapshots, which skip values, but are
+// sent back through a second lock free queue. The steps of a command are always in that queue before the snapshot after
+// the command is published.
+//
+// Once the game thread is being stopped it no longer waits for room in the step queue, so the move it is playing finishes
+// without queueing the rest of its steps. Snapshots published after that may be missing steps, the game in them is still
+// complete.
+//
+// All methods except the constructor and destructor must be called from the same thread, the user interface thread.
+class GameThread {
+public:
+    struct Snapshot {
+        CandyCrush game = CandyCrush(0);
+
+        // Number of commands the game thread has handled, the game includes all of them
+        unsigned long numberOfCommands = 0;
+    };
+
+    // A step of a move with the board and score as they were right after it
+    struct BoardStep {
+        CandyCrush::CandyCrushGameBoard gameBoard;
+        CandyCrushGameBoardChange gameBoardChange;
+        int score = 0;
+    };
+
+    // onPublish is called on the game thread whenever new steps or a new snapshot can be read, for example to wake up a
+    // user interface that sleeps until there are events. Every game is recorded and saved to replayPath when saveReplay
+    // is called, unless replayPath is empty.
+    GameThread(std::function<void()> onPublish, std::string replayPath);
+    ~GameThread();
+
+    // Commands are handled in the order they were sent
+    void startNewGame(uint64_t seed, CandyCrush::Clock clock = CandyCrush::Clock::wallClock());
+    void play(GameBoard::CellSwapMove move);
+    void saveReplay();
+
+    // Number of commands sent, the snapshot is up to date with them when it has handled as many
+    unsigned long numberOfCommands() const {
+        return numberOfCommandsSent;
+    }
+
+    // Takes the latest snapshot if there is a new one, returns whether there was
+    bool updateSnapshot() {
+        return snapshots.update();
+    }
+
+    // The snapshot taken by the last updateSnapshot
+    const Snapshot& snapshot() const {
+        return snapshots.frontBuffer();
+    }
+
+    // Returns false if there are no more steps
+    bool popBoardStep(BoardStep& boardStep) {
+        return boardSteps.pop(boardStep);
+    }
+
+private:
+    struct Command {
+        enum Type {NewGame, Move, SaveReplay};
+        Type type = Move;
+        uint64_t seed = 0;
+        CandyCrush::Clock clock = CandyCrush::Clock::wallClock();
+        GameBoard::CellSwapMove move = GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 0));
+    };
+
+    // Owned by the game thread
+    CandyCrush game = CandyCrush(0);
+    Replay::Writer replayWriter = Replay::Writer(game);
+    unsigned long numberOfCommandsHandled = 0;
+
+    // Owned by the user interface thread
+    unsigned long numberOfCommandsSent = 0;
+
+    std::function<void()> onPublish;
+    std::string replayPath;
+    SingleProducerSingleConsumerQueue<Command, 64> commands;
+    SingleProducerSingleConsumerQueue<BoardStep, 64> boardSteps;
+    TripleBuffer<Snapshot> snapshots;
+
+    // The queues are lock free, the mutex is only used by the game thread to sleep until there is a command
+    std::mutex wakeUpMutex;
+    std::condition_variable wakeUp;
+    std::atomic<bool> isStopping {false};
+    std::thread thread;
+
+    void send(const Command& command);
+    void run();
+    void handle(const Command& command);
+    void publishSnapshot();
+};
+
+#endif /* GameThread_hpp */
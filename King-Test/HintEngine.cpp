@@ -0,0 +1,140 @@
+#include "HintEngine.hpp"
+#include <algorithm>
+#include <vector>
+#include "ThreadCpuClock.hpp"
+#include "Trace.hpp"
+
+namespace {
+
+    struct MoveEvaluation {
+        GameBoard::CellSwapMove move;
+        int immediateScoreGain = 0;
+        double totalScoreGain = 0;
+        int numberOfSamples = 0;
+
+        MoveEvaluation(GameBoard::CellSwapMove move, int immediateScoreGain): move(move), immediateScoreGain(immediateScoreGain) {}
+
+        double expectedScoreGain() const {
+            return numberOfSamples > 0 ? totalScoreGain / numberOfSamples : immediateScoreGain;
+        }
+    };
+
+    // Most score any single move gains on the board, including its cascades with new cells from the given seed
+    int bestScoreGain(const CandyCrush& game, uint64_t seed) {
+        auto bestGain = 0;
+        for (const auto& move: game.legalMoves()) {
+            bestGain = std::max(bestGain, game.outcomeForMove(move, seed).getScore() - game.getScore());
+        }
+        return bestGain;
+    }
+}
+
+HintEngine::HintEngine(): HintEngine(Configuration()) {}
+
+HintEngine::HintEngine(Configuration configuration): configuration(configuration) {
+    thread = std::thread([this] {
+        run();
+    });
+}
+
+HintEngine::~HintEngine() {
+    {
+        std::lock_guard<std::mutex> lock(wakeUpMutex);
+        isStopping = true;
+    }
+    wakeUp.notify_one();
+    thread.join();
+}
+
+void HintEngine::search(const CandyCrush& game) {
+    auto& request = requests.backBuffer();
+    request.game = game;
+    request.searchNumber = ++latestSearchNumber;
+    requests.publish();
+
+    // Taking the mutex makes sure that the search thread is either before its check for requests or already waiting
+    {
+        std::lock_guard<std::mutex> lock(wakeUpMutex);
+    }
+    wakeUp.notify_one();
+}
+
+void HintEngine::cancel() {
+    ++latestSearchNumber;
+}
+
+bool HintEngine::bestHint(Hint& hint) {
+    hints.update();
+    if (hints.frontBuffer().searchNumber != latestSearchNumber) {
+        return false;
+    }
+    hint = hints.frontBuffer();
+    return true;
+}
+
+void HintEngine::run() {
+    Trace::setThreadName("Hints");
+    while (!isStopping) {
+        if (requests.update()) {
+            const auto& request = requests.frontBuffer();
+            if (request.searchNumber == latestSearchNumber) {
+                runSearch(request.game, request.searchNumber);
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeUpMutex);
+        wakeUp.wait(lock, [this] {
+            return isStopping || requests.hasNewValue();
+        });
+    }
+}
+
+void HintEngine::runSearch(const CandyCrush& game, unsigned long searchNumber) {
+    TRACE_SPAN("hintSearch");
+    // The budget is CPU time of this thread, so that it is not used up while the thread is not running
+    auto endCpuTime = ThreadCpuClock::now() + configuration.cpuBudget;
+    auto isCancelled = [&] {
+        return isStopping || latestSearchNumber != searchNumber;
+    };
+
+    auto publishBestMove = [&](const std::vector<MoveEvaluation>& evaluations) {
+        auto best = std::max_element(evaluations.begin(), evaluations.end(), [](const MoveEvaluation& a, const MoveEvaluation& b) {
+            return a.expectedScoreGain() < b.expectedScoreGain();
+        });
+        auto& hint = hints.backBuffer();
+        hint.move = best->move;
+        hint.expectedScoreGain = best->expectedScoreGain();
+        hint.numberOfSamples = best->numberOfSamples;
+        hint.searchNumber = searchNumber;
+        hints.publish();
+    };
+
+    // Every swap is listed in both directions, one of them is enough
+    std::vector<MoveEvaluation> evaluations;
+    for (const auto& move: game.legalMoves()) {
+        if (move.from.row < move.to.row || move.from.column < move.to.column) {
+            evaluations.push_back(MoveEvaluation(move, game.outcomeForMove(move, configuration.seed).getScore() - game.getScore()));
+        }
+    }
+    if (evaluations.empty() || isCancelled()) {
+        return;
+    }
+    publishBestMove(evaluations);
+
+    RandomGenerator randomGenerator(configuration.seed ^ searchNumber);
+    for (auto round = 0; round < configuration.maxSamplesPerMove; round++) {
+        auto seed = randomGenerator.next();
+        for (auto& evaluation: evaluations) {
+            if (isCancelled()) {
+                return;
+            }
+            auto outcome = game.outcomeForMove(evaluation.move, seed);
+            evaluation.totalScoreGain += outcome.getScore() - game.getScore() + bestScoreGain(outcome, seed);
+            evaluation.numberOfSamples++;
+        }
+        publishBestMove(evaluations);
+        if (ThreadCpuClock::now() >= endCpuTime) {
+            return;
+        }
+    }
+}
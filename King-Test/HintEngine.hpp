@@ -0,0 +1,76 @@
+#ifndef HintEngine_hpp
+#define HintEngine_hpp
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "CandyCrush.hpp"
+#include "TripleBuffer.hpp"
+
+// Looks for a move to suggest to the player on a background thread, so that a user interface never waits for it.
+//
+// A search first ranks the legal moves by the score they give with one fixed set of new cells, which gives a hint almost at
+// once. It then refines the ranking in rounds until its CPU budget is used up. Every round plays each move once more with new
+// random cells, including its cascades, and adds the best score any single move could gain on the board after it with the
+// same cells. Moves are only ever played with outcomeForMove, so a hint never depends on the cells the game will get. All moves of a round see the same random cells, so they are compared on equal terms. The best move is
+// published after every round, so a hint can be shown at any time and only gets better.
+//
+// Starting a new search or cancelling stops the current one before its next move evaluation, which is a few microseconds.
+// All methods must be called from the same thread.
+class HintEngine {
+public:
+    struct Configuration {
+        std::chrono::microseconds cpuBudget = std::chrono::microseconds(250000);
+
+        // A search stops early when every move has been sampled this many times
+        int maxSamplesPerMove = 256;
+        uint64_t seed = 1;
+    };
+
+    struct Hint {
+        GameBoard::CellSwapMove move = GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 0));
+        double expectedScoreGain = 0;
+
+        // Number of sampled outcomes the expected score gain is averaged over, 0 while the moves have only been scored with the fixed cells
+        int numberOfSamples = 0;
+        unsigned long searchNumber = 0;
+    };
+
+    HintEngine();
+    HintEngine(Configuration configuration);
+    ~HintEngine();
+
+    // Starts searching the game for a hint and cancels the search that is running, if any
+    void search(const CandyCrush& game);
+    void cancel();
+
+    // Returns false until the current search has found a hint, and always after it has been cancelled
+    bool bestHint(Hint& hint);
+
+private:
+    struct Request {
+        CandyCrush game = CandyCrush(0);
+        unsigned long searchNumber = 0;
+    };
+
+    Configuration configuration;
+
+    // Number of the latest search started, increased by cancel too so that the search that is running stops
+    std::atomic<unsigned long> latestSearchNumber {0};
+    TripleBuffer<Request> requests;
+    TripleBuffer<Hint> hints;
+
+    // Only used by the search thread to sleep until there is a request
+    std::mutex wakeUpMutex;
+    std::condition_variable wakeUp;
+    std::atomic<bool> isStopping {false};
+    std::thread thread;
+
+    void run();
+    void runSearch(const CandyCrush& game, unsigned long searchNumber);
+};
+
+#endif /* HintEngine_hpp */
@@ -0,0 +1,465 @@
+#include "HugeBoard.hpp"
+#include "RandomGenerator.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const size_t HugeBoardGame::tileSize;
+const size_t HugeBoardGame::minimumSize;
+const size_t HugeBoardGame::maximumSize;
+const size_t HugeBoardGame::maximumNumberOfCellTypes;
+
+// Threads that wait for passes over the bands of the board. A pass wakes every worker, the calling thread takes bands as
+// well, and it only returns once every worker is done with the pass, since the action lives on the stack of the caller.
+class HugeBoardGame::WorkerPool {
+private:
+    std::mutex mutex;
+    std::condition_variable passStarted;
+    std::condition_variable passFinished;
+    bool isStopping = false;
+
+    // The pass that is running. A worker takes part in a pass when the pass number differs from the last one it worked on.
+    unsigned long passNumber = 0;
+    const void* action = nullptr;
+    void (*runAction)(const void* action, size_t band) = nullptr;
+    size_t numberOfBands = 0;
+    std::atomic<size_t> nextBand {0};
+    size_t numberOfBusyWorkers = 0;
+
+    std::vector<std::thread> threads;
+
+    // Bands are handed out one at a time, so a thread that gets cheap bands simply takes more of them
+    void takeBands() {
+        for (auto band = nextBand++; band < numberOfBands; band = nextBand++) {
+            runAction(action, band);
+        }
+    }
+
+    void runWorker() {
+        unsigned long lastPassNumber = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                passStarted.wait(lock, [&] {
+                    return isStopping || passNumber != lastPassNumber;
+                });
+                if (isStopping) {
+                    return;
+                }
+                lastPassNumber = passNumber;
+            }
+            takeBands();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--numberOfBusyWorkers == 0) {
+                passFinished.notify_one();
+            }
+        }
+    }
+
+public:
+    WorkerPool(unsigned int numberOfThreads) {
+        for (unsigned int i = 0; i < numberOfThreads; i++) {
+            threads.push_back(std::thread([this] {
+                runWorker();
+            }));
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopping = true;
+        }
+        passStarted.notify_all();
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+
+    template<typename Action>
+    void forEachBand(size_t numberOfBands, const Action& action) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->action = &action;
+            this->runAction = [](const void* action, size_t band) {
+                (*(const Action*)action)(band);
+            };
+            this->numberOfBands = numberOfBands;
+            nextBand = 0;
+            numberOfBusyWorkers = threads.size();
+            passNumber++;
+        }
+        passStarted.notify_all();
+        takeBands();
+        std::unique_lock<std::mutex> lock(mutex);
+        passFinished.wait(lock, [this] {
+            return numberOfBusyWorkers == 0;
+        });
+    }
+};
+
+std::unique_ptr<HugeBoardGame> HugeBoardGame::make(size_t rows, size_t columns, size_t numberOfCellTypes, uint64_t seed, unsigned int numberOfThreads) {
+    if (rows < minimumSize || rows > maximumSize || columns < minimumSize || columns > maximumSize) {
+        return nullptr;
+    }
+    if (numberOfCellTypes < 3 || numberOfCellTypes > maximumNumberOfCellTypes) {
+        return nullptr;
+    }
+    if (numberOfThreads == 0) {
+        numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::unique_ptr<HugeBoardGame>(new HugeBoardGame(rows, columns, numberOfCellTypes, seed, numberOfThreads));
+}
+
+HugeBoardGame::HugeBoardGame(size_t rows, size_t columns, size_t numberOfCellTypes, uint64_t seed, unsigned int numberOfThreads):
+numberOfRows(rows),
+numberOfColumns(columns),
+numberOfTileRows((rows + tileSize - 1) / tileSize),
+numberOfTileColumns((columns + tileSize - 1) / tileSize),
+cellTypes(numberOfCellTypes),
+numberOfThreads(numberOfThreads),
+seed(seed),
+tiles(new uint8_t[numberOfTileRows*numberOfTileColumns*tileSize*tileSize]()),
+changedTiles(numberOfTileRows*numberOfTileColumns, 1),
+scannedTiles(numberOfTileRows*numberOfTileColumns, 0) {
+    if (numberOfThreads > 1) {
+        workerPool.reset(new WorkerPool(numberOfThreads - 1));
+    }
+
+    // Every band of tile rows is filled from its own generator. The top two bits keep the seeds of the first fill, of the
+    // replaced cells and of the refilled columns apart.
+    forEachBand(numberOfTileRows, [this](size_t tileRow) {
+        RandomGenerator randomGenerator(this->seed ^ (0x8000000000000000 | tileRow));
+        auto lastRow = std::min((tileRow + 1)*tileSize, numberOfRows);
+        for (auto row = tileRow*tileSize; row < lastRow; row++) {
+            for (size_t column = 0; column < numberOfColumns; column++) {
+                *cellPointer(row, column) = (uint8_t)randomGenerator.nextBelow((uint32_t)cellTypes);
+            }
+        }
+    });
+
+    // The starting board only has to be stable, so matched cells are replaced where they are instead of letting the cells
+    // above fall. Nothing moves, so every round only has to look at the few tiles where cells were replaced.
+    do {
+        scanAroundChangedTiles();
+        markHorizontalMatches();
+        markVerticalMatches();
+        numberOfCascades++;
+    } while (replaceMatchedCells() > 0);
+}
+
+HugeBoardGame::~HugeBoardGame() {}
+
+template<typename Action>
+void HugeBoardGame::forEachBand(size_t numberOfBands, const Action& action) const {
+    if (workerPool == nullptr || numberOfBands <= 1) {
+        for (size_t band = 0; band < numberOfBands; band++) {
+            action(band);
+        }
+        return;
+    }
+    workerPool->forEachBand(numberOfBands, action);
+}
+
+int HugeBoardGame::cellTypeAt(long row, long column) const {
+    if (row < 0 || column < 0 || row >= (long)numberOfRows || column >= (long)numberOfColumns) {
+        return -1;
+    }
+    return *cellPointer((size_t)row, (size_t)column) & cellTypeMask;
+}
+
+bool HugeBoardGame::isLegalMove(GameBoard::CellSwapMove move) const {
+    auto from = move.from;
+    auto to = move.to;
+    if (cellTypeAt(from.row, from.column) < 0 || cellTypeAt(to.row, to.column) < 0) {
+        return false;
+    }
+    if (std::abs(from.row - to.row) + std::abs(from.column - to.column) != 1) {
+        return false;
+    }
+
+    // Cell type at the position as if the two cells had been swapped
+    auto cellTypeAfterSwap = [&](long row, long column) {
+        if (row == from.row && column == from.column) {
+            return cellTypeAt(to.row, to.column);
+        }
+        if (row == to.row && column == to.column) {
+            return cellTypeAt(from.row, from.column);
+        }
+        return cellTypeAt(row, column);
+    };
+
+    // Length of the run through the cell in the given direction, looking no further than needed for a match
+    auto runLength = [&](GameBoard::CellPosition cell, long rowStep, long columnStep) {
+        auto type = cellTypeAfterSwap(cell.row, cell.column);
+        auto length = 1;
+        for (long i = 1; i <= 2 && cellTypeAfterSwap(cell.row - i*rowStep, cell.column - i*columnStep) == type; i++) {
+            length++;
+        }
+        for (long i = 1; i <= 2 && cellTypeAfterSwap(cell.row + i*rowStep, cell.column + i*columnStep) == type; i++) {
+            length++;
+        }
+        return length;
+    };
+    for (auto cell: {move.from, move.to}) {
+        if (runLength(cell, 0, 1) >= 3 || runLength(cell, 1, 0) >= 3) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HugeBoardGame::play(GameBoard::CellSwapMove move) {
+    if (!isLegalMove(move)) {
+        return false;
+    }
+    std::swap(*cellPointer((size_t)move.from.row, (size_t)move.from.column), *cellPointer((size_t)move.to.row, (size_t)move.to.column));
+    markChangedCell(move.from);
+    markChangedCell(move.to);
+    numberOfCascadesInLastMove = clearAllMatches();
+    return true;
+}
+
+void HugeBoardGame::markHorizontalMatches() {
+    forEachBand(numberOfTileRows, [this](size_t tileRow) {
+        auto firstRow = tileRow*tileSize;
+        auto bandRows = std::min(tileSize, numberOfRows - firstRow);
+
+        // The run that is going on in every row of the band, carried from one tile to the next
+        uint8_t runType[tileSize];
+        size_t runLength[tileSize] = {};
+
+        auto markRun = [&](size_t row, size_t endColumn) {
+            if (runLength[row] < 3) {
+                return;
+            }
+            for (size_t i = 1; i <= runLength[row]; i++) {
+                *cellPointer(firstRow + row, endColumn - i) |= matchedFlag;
+            }
+        };
+        for (size_t tileColumn = 0; tileColumn < numberOfTileColumns; tileColumn++) {
+            auto firstColumn = tileColumn*tileSize;
+            auto tileColumns = std::min(tileSize, numberOfColumns - firstColumn);
+            if (!scannedTiles[tileRow*numberOfTileColumns + tileColumn]) {
+                for (size_t row = 0; row < bandRows; row++) {
+                    markRun(row, firstColumn);
+                    runLength[row] = 0;
+                }
+                continue;
+            }
+            for (size_t row = 0; row < bandRows; row++) {
+                auto cells = cellPointer(firstRow + row, firstColumn);
+                for (size_t column = 0; column < tileColumns; column++) {
+                    auto type = (uint8_t)(cells[column] & cellTypeMask);
+                    if (runLength[row] > 0 && type == runType[row]) {
+                        runLength[row]++;
+                    } else {
+                        markRun(row, firstColumn + column);
+                        runType[row] = type;
+                        runLength[row] = 1;
+                    }
+                }
+            }
+        }
+        for (size_t row = 0; row < bandRows; row++) {
+            markRun(row, numberOfColumns);
+        }
+    });
+}
+
+void HugeBoardGame::markVerticalMatches() {
+    forEachBand(numberOfTileColumns, [this](size_t tileColumn) {
+        auto firstColumn = tileColumn*tileSize;
+        auto bandColumns = std::min(tileSize, numberOfColumns - firstColumn);
+
+        // The run that is going on in every column of the band, carried from one tile to the next
+        uint8_t runType[tileSize];
+        size_t runLength[tileSize] = {};
+
+        auto markRun = [&](size_t column, size_t endRow) {
+            if (runLength[column] < 3) {
+                return;
+            }
+            for (size_t i = 1; i <= runLength[column]; i++) {
+                *cellPointer(endRow - i, firstColumn + column) |= matchedFlag;
+            }
+        };
+        for (size_t tileRow = 0; tileRow < numberOfTileRows; tileRow++) {
+            auto firstRow = tileRow*tileSize;
+            auto tileRows = std::min(tileSize, numberOfRows - firstRow);
+            if (!scannedTiles[tileRow*numberOfTileColumns + tileColumn]) {
+                for (size_t column = 0; column < bandColumns; column++) {
+                    markRun(column, firstRow);
+                    runLength[column] = 0;
+                }
+                continue;
+            }
+            for (auto row = firstRow; row < firstRow + tileRows; row++) {
+                auto cells = cellPointer(row, firstColumn);
+                for (size_t column = 0; column < bandColumns; column++) {
+                    auto type = (uint8_t)(cells[column] & cellTypeMask);
+                    if (runLength[column] > 0 && type == runType[column]) {
+                        runLength[column]++;
+                    } else {
+                        markRun(column, row);
+                        runType[column] = type;
+                        runLength[column] = 1;
+                    }
+                }
+            }
+        }
+        for (size_t column = 0; column < bandColumns; column++) {
+            markRun(column, numberOfRows);
+        }
+    });
+}
+
+long HugeBoardGame::applyGravity() {
+    std::vector<long> matchedCellsInBand(numberOfTileColumns);
+    forEachBand(numberOfTileColumns, [this, &matchedCellsInBand](size_t tileColumn) {
+        auto firstColumn = tileColumn*tileSize;
+        auto bandColumns = std::min(tileSize, numberOfColumns - firstColumn);
+
+        // Matched cells can only be in scanned tiles, so everything below the lowest scanned tile stays where it is
+        auto lowestTileRow = -1L;
+        for (size_t tileRow = 0; tileRow < numberOfTileRows; tileRow++) {
+            if (scannedTiles[tileRow*numberOfTileColumns + tileColumn]) {
+                lowestTileRow = (long)tileRow;
+            }
+        }
+        if (lowestTileRow < 0) {
+            return;
+        }
+        auto bottomRow = (long)std::min((size_t)(lowestTileRow + 1)*tileSize, numberOfRows) - 1;
+
+        // Row that the next cell that is kept falls to, for every column of the band
+        long nextRow[tileSize];
+        std::fill(nextRow, nextRow + bandColumns, bottomRow);
+
+        // Rows are walked bottom up so that the reads stay in the same tile row for as long as possible
+        long matchedCells = 0;
+        auto lowestMatchedRow = -1L;
+        for (auto row = bottomRow; row >= 0; row--) {
+            auto cells = cellPointer((size_t)row, firstColumn);
+            for (size_t column = 0; column < bandColumns; column++) {
+                auto cell = cells[column];
+                if (cell & matchedFlag) {
+                    matchedCells++;
+                    lowestMatchedRow = std::max(lowestMatchedRow, row);
+                } else {
+                    if (nextRow[column] != row) {
+                        *cellPointer((size_t)nextRow[column], firstColumn + column) = cell;
+                    }
+                    nextRow[column]--;
+                }
+            }
+        }
+        matchedCellsInBand[tileColumn] = matchedCells;
+        if (matchedCells == 0) {
+            return;
+        }
+
+        // The seed depends on the cascade and the column only, so the new cells do not depend on which thread made them
+        for (size_t column = 0; column < bandColumns; column++) {
+            if (nextRow[column] < 0) {
+                continue;
+            }
+            RandomGenerator randomGenerator(seed ^ (numberOfCascades*numberOfColumns + firstColumn + column));
+            for (auto row = nextRow[column]; row >= 0; row--) {
+                *cellPointer((size_t)row, firstColumn + column) = (uint8_t)randomGenerator.nextBelow((uint32_t)cellTypes);
+            }
+        }
+
+        // Every cell above a matched cell has moved or is new
+        for (size_t tileRow = 0; tileRow <= (size_t)lowestMatchedRow / tileSize; tileRow++) {
+            changedTiles[tileRow*numberOfTileColumns + tileColumn] = 1;
+        }
+    });
+
+    long matchedCells = 0;
+    for (auto cells: matchedCellsInBand) {
+        matchedCells += cells;
+    }
+    return matchedCells;
+}
+
+void HugeBoardGame::markChangedCell(GameBoard::CellPosition cell) {
+    changedTiles[((size_t)cell.row / tileSize)*numberOfTileColumns + (size_t)cell.column / tileSize] = 1;
+}
+
+void HugeBoardGame::scanAroundChangedTiles() {
+
+    // The board was stable before the last changes, so a run of three cells always has a changed cell, and can only
+    // reach two cells into the tiles next to the changed ones. Only those tiles have to be scanned.
+    std::fill(scannedTiles.begin(), scannedTiles.end(), 0);
+    for (size_t tileRow = 0; tileRow < numberOfTileRows; tileRow++) {
+        for (size_t tileColumn = 0; tileColumn < numberOfTileColumns; tileColumn++) {
+            if (!changedTiles[tileRow*numberOfTileColumns + tileColumn]) {
+                continue;
+            }
+            auto firstTileRow = tileRow > 0 ? tileRow - 1 : 0;
+            auto lastTileRow = std::min(tileRow + 1, numberOfTileRows - 1);
+            auto firstTileColumn = tileColumn > 0 ? tileColumn - 1 : 0;
+            auto lastTileColumn = std::min(tileColumn + 1, numberOfTileColumns - 1);
+            for (auto row = firstTileRow; row <= lastTileRow; row++) {
+                scannedTiles[row*numberOfTileColumns + tileColumn] = 1;
+            }
+            for (auto column = firstTileColumn; column <= lastTileColumn; column++) {
+                scannedTiles[tileRow*numberOfTileColumns + column] = 1;
+            }
+        }
+    }
+    std::fill(changedTiles.begin(), changedTiles.end(), 0);
+}
+
+long HugeBoardGame::replaceMatchedCells() {
+    std::vector<long> matchedCellsInBand(numberOfTileRows);
+    forEachBand(numberOfTileRows, [this, &matchedCellsInBand](size_t tileRow) {
+        RandomGenerator randomGenerator(seed ^ (0x4000000000000000 | (numberOfCascades*numberOfTileRows + tileRow)));
+        long matchedCells = 0;
+        for (size_t tileColumn = 0; tileColumn < numberOfTileColumns; tileColumn++) {
+            if (!scannedTiles[tileRow*numberOfTileColumns + tileColumn]) {
+                continue;
+            }
+            auto tile = &tiles[(tileRow*numberOfTileColumns + tileColumn)*tileSize*tileSize];
+            auto tileHasMatches = false;
+            for (size_t i = 0; i < tileSize*tileSize; i++) {
+                if (tile[i] & matchedFlag) {
+                    tile[i] = (uint8_t)randomGenerator.nextBelow((uint32_t)cellTypes);
+                    tileHasMatches = true;
+                    matchedCells++;
+                }
+            }
+            if (tileHasMatches) {
+                changedTiles[tileRow*numberOfTileColumns + tileColumn] = 1;
+            }
+        }
+        matchedCellsInBand[tileRow] = matchedCells;
+    });
+
+    long matchedCells = 0;
+    for (auto cells: matchedCellsInBand) {
+        matchedCells += cells;
+    }
+    return matchedCells;
+}
+
+int HugeBoardGame::clearAllMatches() {
+    auto cascades = 0;
+    while (true) {
+        scanAroundChangedTiles();
+        markHorizontalMatches();
+        markVerticalMatches();
+        auto matchedCells = applyGravity();
+        if (matchedCells == 0) {
+            return cascades;
+        }
+        score += matchedCells;
+        cascades++;
+        numberOfCascades++;
+    }
+}
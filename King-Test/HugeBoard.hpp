@@ -0,0 +1,146 @@
+#ifndef HugeBoard_hpp
+#define HugeBoard_hpp
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "GameBoard.hpp"
+
+// Game on a very large board, from about 1,000x1,000 up to 10,000x10,000 cells, used for stress tests and event modes.
+//
+// Cells are stored on the heap in square tiles of tileSize x tileSize bytes, so a tile is a few pages of memory that is
+// contiguous whichever direction it is scanned in. The top bit of every cell marks it as matched, which keeps the whole
+// game at about one byte per cell.
+//
+// Clearing matches is split over threads in three passes. Horizontal runs are found in bands of tile rows and vertical
+// runs in bands of tile columns, each thread keeping its own run lengths so that runs crossing tile borders inside a band
+// are counted as one. Runs never cross the border of a band, because every band covers whole rows or whole columns.
+// Gravity then compacts every column on its own, again in bands of tile columns. New cells are drawn from a generator
+// seeded by the column and the cascade, so the result does not depend on the number of threads. Late cascades usually
+// touch a few columns only, so every pass skips the tiles that are too far from the cells changed by the last one. The
+// threads are started with the game and wait for the next pass in between, so a pass costs waking them up rather than
+// starting and joining threads, which matters for the short passes of late cascades.
+class HugeBoardGame {
+    
+    // The tests set up cells and run the passes of a cascade on their own
+    friend struct HugeBoardGameTests;
+    
+public:
+    static const size_t tileSize = 64;
+    static const size_t minimumSize = 3;
+    static const size_t maximumSize = 16384;
+
+    // The number of cell types must leave the top bit of a byte free for the matched mark
+    static const size_t maximumNumberOfCellTypes = 127;
+
+    // Returns nullptr if the size or number of cell types is not supported.
+    // A numberOfThreads of 0 uses one thread per hardware thread.
+    static std::unique_ptr<HugeBoardGame> make(size_t rows, size_t columns, size_t numberOfCellTypes, uint64_t seed, unsigned int numberOfThreads = 0);
+
+    ~HugeBoardGame();
+
+    size_t rows() const {
+        return numberOfRows;
+    }
+
+    size_t columns() const {
+        return numberOfColumns;
+    }
+
+    size_t numberOfCellTypes() const {
+        return cellTypes;
+    }
+
+    // Cell types are numbered from zero
+    int cellAt(GameBoard::CellPosition cell) const {
+        return *cellPointer((size_t)cell.row, (size_t)cell.column) & cellTypeMask;
+    }
+
+    long getScore() const {
+        return score;
+    }
+
+    // Number of cascades in the last move
+    int getNumberOfCascadesInLastMove() const {
+        return numberOfCascadesInLastMove;
+    }
+
+    // Bytes held by the board, including the padding of the tiles at the right and bottom edges
+    size_t memoryUsage() const {
+        return numberOfTileRows*numberOfTileColumns*tileSize*tileSize;
+    }
+
+    // Only looks at the cells within two cells of the swap, so it is cheap whatever the size of the board
+    bool isLegalMove(GameBoard::CellSwapMove move) const;
+
+    // Makes the move and clears all cascades it causes, returns whether the move was legal
+    bool play(GameBoard::CellSwapMove move);
+
+private:
+    class WorkerPool;
+
+    static const uint8_t matchedFlag = 0x80;
+    static const uint8_t cellTypeMask = 0x7f;
+
+    size_t numberOfRows;
+    size_t numberOfColumns;
+    size_t numberOfTileRows;
+    size_t numberOfTileColumns;
+    size_t cellTypes;
+    unsigned int numberOfThreads;
+    uint64_t seed;
+    std::unique_ptr<uint8_t[]> tiles;
+
+    // The threads other than the one calling play, nullptr if the game uses one thread
+    std::unique_ptr<WorkerPool> workerPool;
+
+    // One entry per tile. Bytes rather than bits, because threads write the entries of neighbouring tiles at the same time.
+    std::vector<uint8_t> changedTiles;
+    std::vector<uint8_t> scannedTiles;
+    long score = 0;
+    int numberOfCascadesInLastMove = 0;
+
+    // Counts every cascade that has been cleared, so that every cascade refills from different random numbers
+    uint64_t numberOfCascades = 0;
+
+    HugeBoardGame(size_t rows, size_t columns, size_t numberOfCellTypes, uint64_t seed, unsigned int numberOfThreads);
+
+    uint8_t* cellPointer(size_t row, size_t column) {
+        auto tile = (row / tileSize)*numberOfTileColumns + column / tileSize;
+        return &tiles[tile*tileSize*tileSize + (row % tileSize)*tileSize + column % tileSize];
+    }
+
+    const uint8_t* cellPointer(size_t row, size_t column) const {
+        auto tile = (row / tileSize)*numberOfTileColumns + column / tileSize;
+        return &tiles[tile*tileSize*tileSize + (row % tileSize)*tileSize + column % tileSize];
+    }
+
+    // Cell type of the cell, or an invalid type for cells outside the board
+    int cellTypeAt(long row, long column) const;
+
+    // Runs the action for every band index below numberOfBands, spread over the calling thread and the worker pool
+    template<typename Action>
+    void forEachBand(size_t numberOfBands, const Action& action) const;
+
+    void markChangedCell(GameBoard::CellPosition cell);
+
+    // Marks the tiles that changed, and the tiles next to them, in scannedTiles and clears changedTiles
+    void scanAroundChangedTiles();
+
+    // Only the tiles in scannedTiles are looked at
+    void markHorizontalMatches();
+    void markVerticalMatches();
+
+    // Lets the cells above matched cells fall down and refills the top of every column, returns the number of matched cells.
+    // Marks the tiles it changes in changedTiles.
+    long applyGravity();
+
+    // Gives matched cells new random types without moving any cells, returns the number of matched cells.
+    // Marks the tiles it changes in changedTiles.
+    long replaceMatchedCells();
+
+    // Clears matches until the board is stable, returns the number of cascades
+    int clearAllMatches();
+};
+
+#endif /* HugeBoard_hpp */
@@ -0,0 +1,58 @@
+#ifndef LockFreeQueue_hpp
+#define LockFreeQueue_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded queue between exactly one producer thread and one consumer thread.
+//
+// It is lock free: the producer only writes tail and the consumer only writes head, and each publishes its position with
+// a release store that the other side reads with an acquire load, so an element is always completely written before it can
+// be read. The positions only ever increase and are taken modulo the capacity, which is a power of two. They are kept on
+// different cache lines so that the two threads do not slow each other down. That is done with padding rather than alignas,
+// so that objects holding a queue can still be created with plain new.
+template<typename T, size_t CAPACITY>
+class SingleProducerSingleConsumerQueue {
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "The capacity must be a power of two");
+
+private:
+    static const size_t cacheLineSize = 64;
+
+    std::unique_ptr<T[]> elements = std::unique_ptr<T[]>(new T[CAPACITY]);
+    char paddingBeforeHead[cacheLineSize - sizeof(std::unique_ptr<T[]>)];
+    std::atomic<size_t> head {0};
+    char paddingBeforeTail[cacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail {0};
+    char paddingAfterTail[cacheLineSize - sizeof(std::atomic<size_t>)];
+
+public:
+    // Producer only, returns false if the queue is full
+    bool push(const T& element) {
+        auto currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        elements[currentTail % CAPACITY] = element;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, returns false if the queue is empty
+    bool pop(T& element) {
+        auto currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        element = elements[currentHead % CAPACITY];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either thread, the answer may be out of date as soon as it is returned
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif /* LockFreeQueue_hpp */
@@ -0,0 +1,278 @@
+#include "MonteCarloPlayer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    const int outcomesPerMoveLimit = 16;
+
+    struct DecisionNode;
+
+    // A legal move from a game state and the outcomes of playing it that have been sampled so far
+    struct MoveNode {
+        GameBoard::CellSwapMove move;
+        std::atomic<long> numberOfVisits {0};
+        std::atomic<long> totalReward {0};
+
+        // Outcomes are only ever added, a slot is written before the count that makes it visible
+        std::mutex outcomesMutex;
+        std::atomic<int> numberOfOutcomes {0};
+        DecisionNode* outcomes[outcomesPerMoveLimit] = {};
+
+        MoveNode(GameBoard::CellSwapMove move): move(move) {}
+    };
+
+    // A game state where the player chooses a move, its moves are created the first time the node is visited.
+    // The game is kept packed and only unpacked when the node is expanded or a new outcome is played from it, which keeps
+    // nodes small enough for searches with tens of millions of them.
+    struct DecisionNode {
+        const CandyCrush::PackedState state;
+        const bool hasLegalMoves;
+        std::mutex expandMutex;
+        std::atomic<bool> isExpanded {false};
+        MoveNode* moves = nullptr;
+        int numberOfMoves = 0;
+
+        DecisionNode(const CandyCrush& game): state(game.pack()), hasLegalMoves(game.hasLegalMoves()) {}
+    };
+
+    struct Search {
+        const MonteCarloPlayer::Configuration& configuration;
+        const int rootScore;
+        const CandyCrush rootGame;
+        DecisionNode root;
+
+        // Every thread creates its nodes in its own arena of the player. The nodes hold mutexes, so the search destroys them
+        // before the arenas are reset and their memory is reused.
+        std::vector<Arena>& arenas;
+        std::chrono::steady_clock::time_point endTime;
+        std::atomic<long> numberOfNodes {1};
+        std::atomic<long> numberOfIterations {0};
+
+        // Rewards are scaled by the largest reward seen so that the exploration constant works for any score function
+        std::atomic<long> largestReward {1};
+
+        Search(const MonteCarloPlayer::Configuration& configuration, const CandyCrush& game, std::vector<Arena>& arenas): configuration(configuration), rootScore(game.getScore()), rootGame(game), root(game), arenas(arenas) {
+            arenas.resize(std::max(configuration.numberOfThreads, 1u));
+            for (auto& arena: arenas) {
+                arena.reset();
+            }
+        }
+
+        // Walks the tree with a stack of its own, since a tree can be as deep as a game is long
+        ~Search() {
+            std::vector<DecisionNode*> nodes = {&root};
+            while (!nodes.empty()) {
+                auto node = nodes.back();
+                nodes.pop_back();
+                for (auto i = 0; i < node->numberOfMoves; i++) {
+                    auto& move = node->moves[i];
+                    nodes.insert(nodes.end(), move.outcomes, move.outcomes + move.numberOfOutcomes);
+                    move.~MoveNode();
+                }
+                if (node != &root) {
+                    node->~DecisionNode();
+                }
+            }
+        }
+
+        bool isBudgetExhausted() const {
+            if (configuration.maxNodes > 0 && numberOfNodes >= configuration.maxNodes) {
+                return true;
+            }
+            return std::chrono::steady_clock::now() >= endTime;
+        }
+
+        void expand(DecisionNode& node, Arena& arena) {
+            std::lock_guard<std::mutex> lock(node.expandMutex);
+            if (node.isExpanded) {
+                return;
+            }
+            auto moves = CandyCrush(node.state).legalMoves();
+
+            // Every swap is listed in both directions by legalMoves, one of them is enough
+            moves.erase(std::remove_if(moves.begin(), moves.end(), [](GameBoard::CellSwapMove move) {
+                return move.to.row < move.from.row || move.to.column < move.from.column;
+            }), moves.end());
+
+            // The moves of a node are one array so that selecting a move reads them in order
+            node.moves = (MoveNode*)arena.allocate(moves.size()*sizeof(MoveNode), alignof(MoveNode));
+            for (size_t i = 0; i < moves.size(); i++) {
+                new (&node.moves[i]) MoveNode(moves[i]);
+            }
+            node.numberOfMoves = (int)moves.size();
+            node.isExpanded = true;
+        }
+
+        // Only called for nodes that have legal moves
+        MoveNode& selectMove(DecisionNode& node) const {
+            assert(node.numberOfMoves > 0);
+            auto scale = (double)largestReward;
+            long parentVisits = 1;
+            for (auto i = 0; i < node.numberOfMoves; i++) {
+                parentVisits += node.moves[i].numberOfVisits;
+            }
+            auto logParentVisits = std::log((double)parentVisits);
+
+            MoveNode* bestMove = &node.moves[0];
+            auto bestValue = -1.0;
+            for (auto i = 0; i < node.numberOfMoves; i++) {
+                auto& move = node.moves[i];
+                long visits = move.numberOfVisits;
+                if (visits == 0) {
+                    return move;
+                }
+                auto value = move.totalReward / scale / visits + configuration.explorationConstant * std::sqrt(logParentVisits / visits);
+                if (value > bestValue) {
+                    bestValue = value;
+                    bestMove = &move;
+                }
+            }
+            return *bestMove;
+        }
+
+        // Returns an outcome of the move and whether it was just created, in which case its game is also written to outcomeGame
+        std::pair<DecisionNode*, bool> outcomeForMove(const DecisionNode& parent, MoveNode& move, RandomGenerator& randomGenerator, Arena& arena, CandyCrush& outcomeGame) {
+            auto maxOutcomes = std::min(std::max(configuration.maxOutcomesPerMove, 1), outcomesPerMoveLimit);
+            if (move.numberOfOutcomes < maxOutcomes) {
+                std::lock_guard<std::mutex> lock(move.outcomesMutex);
+                int numberOfOutcomes = move.numberOfOutcomes;
+                if (numberOfOutcomes < maxOutcomes) {
+                    outcomeGame = CandyCrush(parent.state).outcomeForMove(move.move, randomGenerator.next());
+                    move.outcomes[numberOfOutcomes] = arena.make<DecisionNode>(outcomeGame);
+                    move.numberOfOutcomes = numberOfOutcomes+1;
+                    numberOfNodes++;
+                    return {move.outcomes[numberOfOutcomes], true};
+                }
+            }
+            return {move.outcomes[randomGenerator.nextBelow((uint32_t)maxOutcomes)], false};
+        }
+
+        // Plays random moves from the game and returns the score at the end
+        int rollout(CandyCrush game, RandomGenerator& randomGenerator) const {
+            for (auto i = 0; i < configuration.rolloutDepth && game.hasLegalMoves(); i++) {
+                auto moves = game.legalMoves();
+                game = game.outcomeForMove(moves[randomGenerator.nextBelow((uint32_t)moves.size())], randomGenerator.next());
+            }
+            return game.getScore();
+        }
+
+        // Score gained by a rollout from the game, reusing an earlier rollout from the same board if there is one
+        int estimatedScoreGain(const CandyCrush& game, RandomGenerator& randomGenerator) const {
+            auto key = std::hash<CandyCrush::CandyCrushGameBoard>()(game.getGameBoard());
+            int scoreGain;
+            if (configuration.transpositionTable != nullptr && configuration.transpositionTable->lookup(key, scoreGain)) {
+                return scoreGain;
+            }
+            scoreGain = rollout(game, randomGenerator) - game.getScore();
+            if (configuration.transpositionTable != nullptr) {
+                configuration.transpositionTable->store(key, scoreGain);
+            }
+            return scoreGain;
+        }
+
+        // The path is a buffer of the calling thread, so that an iteration only allocates when the tree gets deeper than before
+        void runIteration(RandomGenerator& randomGenerator, Arena& arena, std::vector<MoveNode*>& path) {
+            path.clear();
+            auto node = &root;
+            auto game = rootGame;
+            auto isGameUnpacked = true;
+
+            // Walk down the tree until a new game state is reached or the game cannot continue
+            while (node->hasLegalMoves) {
+                if (!node->isExpanded) {
+                    expand(*node, arena);
+                }
+                auto& move = selectMove(*node);
+                move.numberOfVisits += configuration.virtualLoss;
+                path.push_back(&move);
+
+                auto outcome = outcomeForMove(*node, move, randomGenerator, arena, game);
+                node = outcome.first;
+                isGameUnpacked = outcome.second;
+                if (outcome.second) {
+                    break;
+                }
+            }
+            if (!isGameUnpacked) {
+                game = CandyCrush(node->state);
+            }
+            long reward = game.getScore() + estimatedScoreGain(game, randomGenerator) - rootScore;
+            auto largest = largestReward.load();
+            while (reward > largest && !largestReward.compare_exchange_weak(largest, reward)) {}
+
+            // Replace the virtual loss with the real result
+            for (auto move: path) {
+                move->totalReward += reward;
+                move->numberOfVisits += 1 - configuration.virtualLoss;
+            }
+            numberOfIterations++;
+        }
+    };
+}
+
+MonteCarloPlayer::MonteCarloPlayer() {}
+
+MonteCarloPlayer::MonteCarloPlayer(Configuration configuration): configuration(configuration) {}
+
+void MonteCarloPlayer::setSeed(uint64_t seed) {
+    assert(!isSearching && "The seed of a search can not change while it runs");
+    configuration.seed = seed;
+}
+
+MonteCarloPlayer::SearchResult MonteCarloPlayer::search(const CandyCrush& game) {
+    if (!game.hasLegalMoves()) {
+        return SearchResult();
+    }
+    auto wasSearching = isSearching.exchange(true);
+    assert(!wasSearching && "A player runs one search at a time");
+    (void)wasSearching;
+    
+    auto startTime = std::chrono::steady_clock::now();
+    Search search(configuration, game, arenas);
+    search.endTime = startTime + configuration.timeBudget;
+    search.expand(search.root, search.arenas[0]);
+
+    auto searchThread = [&](unsigned int threadIndex) {
+        RandomGenerator randomGenerator(configuration.seed + threadIndex);
+        std::vector<MoveNode*> path;
+        do {
+            search.runIteration(randomGenerator, search.arenas[threadIndex], path);
+        } while (!search.isBudgetExhausted());
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < configuration.numberOfThreads; i++) {
+        threads.emplace_back(searchThread, i);
+    }
+    searchThread(0);
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    // The most visited move is the most robust choice, its average reward is the expected gain
+    SearchResult result;
+    long mostVisits = -1;
+    for (auto i = 0; i < search.root.numberOfMoves; i++) {
+        auto& move = search.root.moves[i];
+        if (move.numberOfVisits > mostVisits) {
+            mostVisits = move.numberOfVisits;
+            result.bestMove = move.move;
+            result.expectedScoreGain = mostVisits > 0 ? (double)move.totalReward / mostVisits : 0;
+        }
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.numberOfNodes = search.numberOfNodes;
+    result.numberOfIterations = search.numberOfIterations;
+    for (auto& arena: search.arenas) {
+        result.numberOfBytesForNodes += arena.bytesUsed();
+    }
+    result.nodesPerSecond = seconds > 0 ? search.numberOfNodes / seconds : 0;
+    isSearching = false;
+    return result;
+}
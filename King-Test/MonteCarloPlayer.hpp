@@ -0,0 +1,76 @@
+#ifndef MonteCarloPlayer_hpp
+#define MonteCarloPlayer_hpp
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "Arena.hpp"
+#include "CandyCrush.hpp"
+#include "TranspositionTable.hpp"
+
+// Reference bot that picks moves with Monte Carlo tree search.
+//
+// New cells are random, so playing a move is a chance event. Every move in the tree has up to maxOutcomesPerMove sampled
+// outcomes, each played with its own seed. Once all of them exist, later visits pick one of them at random, which keeps the
+// tree finite while still averaging over the possible refills. Several threads search the same tree at once. A move that
+// a thread is exploring counts as visited with zero reward until the result is known (virtual loss), which steers the other
+// threads to different parts of the tree.
+//
+// The nodes of a search are created in arenas owned by the player, which keeps their memory for its next search and frees
+// it when the player is destroyed. A player must therefore only run one search at a time, which is asserted. Threads that
+// search at the same time need a player each.
+class MonteCarloPlayer {
+public:
+    struct Configuration {
+
+        // The search stops when the time is up or when maxNodes game states have been created, whichever comes first
+        std::chrono::microseconds timeBudget = std::chrono::microseconds(16000);
+        long maxNodes = 0;
+
+        unsigned int numberOfThreads = 1;
+        int maxOutcomesPerMove = 4;
+
+        // Number of random moves played from a new game state to estimate how good it is
+        int rolloutDepth = 2;
+
+        double explorationConstant = 1.4;
+        int virtualLoss = 1;
+        uint64_t seed = 1;
+
+        // Optional table of rollout results by board hash, so positions that are reached again are not rolled out again.
+        // It can be shared by searches on any number of threads as long as they use the same rollout depth.
+        TranspositionTable<int>* transpositionTable = nullptr;
+    };
+
+    struct SearchResult {
+        GameBoard::CellSwapMove bestMove = GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 0));
+
+        // Average score gained over the searched horizon when starting with the best move
+        double expectedScoreGain = 0;
+
+        long numberOfNodes = 0;
+        long numberOfIterations = 0;
+
+        // Memory taken by the nodes of the tree
+        size_t numberOfBytesForNodes = 0;
+        double nodesPerSecond = 0;
+    };
+
+    MonteCarloPlayer();
+    MonteCarloPlayer(Configuration configuration);
+
+    // Searches from the game. A game without legal moves is not searched, its result has no nodes and the default move.
+    SearchResult search(const CandyCrush& game);
+
+    // Seed of the next searches, so that a player kept for many searches can give each of them its own random choices
+    void setSeed(uint64_t seed);
+
+private:
+    Configuration configuration;
+    std::atomic<bool> isSearching {false};
+
+    // One arena for every search thread, the nodes in them are destroyed at the end of every search
+    std::vector<Arena> arenas;
+};
+
+#endif /* MonteCarloPlayer_hpp */
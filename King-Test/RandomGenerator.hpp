@@ -0,0 +1,51 @@
+#ifndef RandomGenerator_hpp
+#define RandomGenerator_hpp
+
+#include <cstdint>
+
+// Small and fast pseudo random generator (xoshiro256** by Blackman and Vigna) that is owned by a single game.
+// Unlike rand() it has no global state, so games on different threads never share or lock anything, and copying
+// a game copies the generator which makes the copy draw exactly the same cells as the original would have.
+class RandomGenerator {
+private:
+    uint64_t state[4];
+
+    static uint64_t rotateLeft(const uint64_t value, const int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+public:
+    // The seed is spread over the whole state with splitmix64 so that similar seeds give unrelated sequences
+    RandomGenerator(uint64_t seed) {
+        for (auto& word: state) {
+            seed += 0x9e3779b97f4a7c15;
+            auto z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        const auto result = rotateLeft(state[1] * 5, 7) * 9;
+        const auto t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotateLeft(state[3], 45);
+        return result;
+    }
+
+    // Number in [0, bound) without a division, the bias is far below anything a game could notice
+    uint32_t nextBelow(const uint32_t bound) {
+        return (uint32_t)(((next() >> 32) * bound) >> 32);
+    }
+
+    bool operator==(const RandomGenerator& generator) const {
+        return state[0] == generator.state[0] && state[1] == generator.state[1] && state[2] == generator.state[2] && state[3] == generator.state[3];
+    }
+};
+
+#endif /* RandomGenerator_hpp */
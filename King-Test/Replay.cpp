@@ -0,0 +1,188 @@
+#include "Replay.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Replay {
+
+    namespace {
+
+        void appendLittleEndian(std::vector<uint8_t>& bytes, uint64_t value, size_t size) {
+            for (size_t i = 0; i < size; i++) {
+                bytes.push_back((uint8_t)(value >> (8*i)));
+            }
+        }
+
+        uint64_t readLittleEndian(const uint8_t* bytes, size_t size) {
+            uint64_t value = 0;
+            for (size_t i = 0; i < size; i++) {
+                value |= (uint64_t)bytes[i] << (8*i);
+            }
+            return value;
+        }
+
+        const uint32_t maxMilliseconds = (1 << 24) - 1;
+        const uint32_t cellBits = 0x3f;
+        const uint32_t downBit = 0x40;
+        const uint32_t acceptedBit = 0x80;
+    }
+
+    Writer::Writer(const CandyCrush& game) {
+
+        // Room for a few minutes of moves so that recording does not allocate during a normal game
+        bytes.reserve(headerSize + 4096*moveSize);
+        bytes.insert(bytes.end(), {'C', 'C', 'R', 'P'});
+        appendLittleEndian(bytes, formatVersion, 2);
+        appendLittleEndian(bytes, CandyCrush::rulesVersion, 2);
+        appendLittleEndian(bytes, CandyCrush::CandyCrushGameBoard::rows, 1);
+        appendLittleEndian(bytes, CandyCrush::CandyCrushGameBoard::columns, 1);
+        appendLittleEndian(bytes, CandyCrush::numberOfCellTypes, 1);
+        appendLittleEndian(bytes, 0, 1);
+        appendLittleEndian(bytes, (uint64_t)game.getTimeLimitInSeconds(), 4);
+        appendLittleEndian(bytes, game.getSeed(), 8);
+    }
+
+    void Writer::recordMove(const CandyCrush& game, GameBoard::CellSwapMove move, bool wasAccepted) {
+        auto cell = move.from;
+        auto adjacentCell = move.to;
+        // Only swaps of two cells on the board can be stored, a cell off the board would not fit in the cell index of the record
+        if (!game.getGameBoard().areCellsAdjacent(cell, adjacentCell)) {
+            return;
+        }
+
+        // A swap gives the same game whichever cell it starts from, so only the top or left cell is stored
+        if (adjacentCell.row < cell.row || adjacentCell.column < cell.column) {
+            std::swap(cell, adjacentCell);
+        }
+        auto milliseconds = game.getNumberOfMillisecondsElapsedInLastMove();
+        uint32_t record = (uint32_t)(cell.row*CandyCrush::CandyCrushGameBoard::columns + cell.column);
+        record |= adjacentCell.row != cell.row ? downBit : 0;
+        record |= wasAccepted ? acceptedBit : 0;
+        record |= (uint32_t)std::min<long>(milliseconds, maxMilliseconds) << 8;
+        appendLittleEndian(bytes, record, moveSize);
+    }
+
+    size_t Writer::numberOfMoves() const {
+        return (bytes.size() - headerSize) / moveSize;
+    }
+
+    const std::vector<uint8_t>& Writer::getBytes() const {
+        return bytes;
+    }
+
+    bool Writer::save(const std::string& path) const {
+        auto file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        auto didWrite = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        return std::fclose(file) == 0 && didWrite;
+    }
+
+    Reader::~Reader() {
+        if (data != nullptr) {
+            munmap((void*)data, size);
+        }
+    }
+
+    std::unique_ptr<Reader> Reader::open(const std::string& path) {
+        auto fileDescriptor = ::open(path.c_str(), O_RDONLY);
+        if (fileDescriptor < 0) {
+            return nullptr;
+        }
+        struct stat fileStatus;
+        if (fstat(fileDescriptor, &fileStatus) != 0 || (size_t)fileStatus.st_size < headerSize) {
+            close(fileDescriptor);
+            return nullptr;
+        }
+
+        // The mapping stays valid after the file is closed
+        auto mapping = mmap(nullptr, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        close(fileDescriptor);
+        if (mapping == MAP_FAILED) {
+            return nullptr;
+        }
+        std::unique_ptr<Reader> reader(new Reader());
+        reader->data = (const uint8_t*)mapping;
+        reader->size = (size_t)fileStatus.st_size;
+
+        // Moves are read front to back
+        madvise(mapping, reader->size, MADV_SEQUENTIAL);
+
+        auto header = reader->data;
+        auto isReplay = header[0] == 'C' && header[1] == 'C' && header[2] == 'R' && header[3] == 'P' && readLittleEndian(header + 4, 2) == formatVersion;
+        auto hasSameRules = readLittleEndian(header + 6, 2) == CandyCrush::rulesVersion
+        && header[8] == CandyCrush::CandyCrushGameBoard::rows
+        && header[9] == CandyCrush::CandyCrushGameBoard::columns
+        && header[10] == CandyCrush::numberOfCellTypes;
+        if (!isReplay || !hasSameRules) {
+            return nullptr;
+        }
+        return reader;
+    }
+
+    uint64_t Reader::getSeed() const {
+        return readLittleEndian(data + 16, 8);
+    }
+
+    int Reader::getTimeLimitInSeconds() const {
+        return (int)readLittleEndian(data + 12, 4);
+    }
+
+    size_t Reader::numberOfMoves() const {
+        return (size - headerSize) / moveSize;
+    }
+
+    Move Reader::moveAt(size_t index) const {
+        auto record = (uint32_t)readLittleEndian(data + headerSize + index*moveSize, moveSize);
+        auto columns = (int)CandyCrush::CandyCrushGameBoard::columns;
+        GameBoard::CellPosition cell((int)(record & cellBits) / columns, (int)(record & cellBits) % columns);
+        Move move;
+        move.move = GameBoard::CellSwapMove(cell, GameBoard::CellPosition(cell.row + ((record & downBit) ? 1 : 0), cell.column + ((record & downBit) ? 0 : 1)));
+        move.wasAccepted = (record & acceptedBit) != 0;
+        move.millisecondsSinceStart = record >> 8;
+        return move;
+    }
+
+    namespace {
+
+        // Plays the move unless the recorded game had already run out of time, returns whether the move was accepted
+        bool playMove(CandyCrush& game, const Move& move, uint32_t timeLimitInMilliseconds) {
+            return move.millisecondsSinceStart < timeLimitInMilliseconds && game.play(move.move);
+        }
+    }
+
+    // Replayed games are on a virtual clock that stands still, whether a move was in time is decided by its recorded time alone
+    VerificationResult verify(const Reader& reader) {
+        VerificationResult result;
+        CandyCrush game(reader.getSeed(), CandyCrush::Clock::virtualClock(0));
+        auto timeLimitInMilliseconds = (uint32_t)reader.getTimeLimitInSeconds()*1000;
+        for (size_t i = 0; i < reader.numberOfMoves(); i++) {
+            auto move = reader.moveAt(i);
+            if (playMove(game, move, timeLimitInMilliseconds) != move.wasAccepted) {
+                result.firstMismatch = (long)i;
+                break;
+            }
+            result.numberOfMoves++;
+        }
+        result.score = game.getScore();
+        return result;
+    }
+
+    CandyCrush fastForward(const Reader& reader, size_t numberOfMoves) {
+        CandyCrush game(reader.getSeed(), CandyCrush::Clock::virtualClock(0));
+        auto timeLimitInMilliseconds = (uint32_t)reader.getTimeLimitInSeconds()*1000;
+        for (size_t i = 0; i < std::min(numberOfMoves, reader.numberOfMoves()); i++) {
+            auto move = reader.moveAt(i);
+
+            // Rejected moves never change the game
+            if (move.wasAccepted) {
+                playMove(game, move, timeLimitInMilliseconds);
+            }
+        }
+        return game;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef Replay_hpp
+#define Replay_hpp
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CandyCrush.hpp"
+
+// Recording and playback of games, used to reproduce bugs reported by players and to audit scores without playing games
+// in real time.
+//
+// A replay is a 24 byte header followed by one 4 byte record per move, all little endian:
+//
+//     offset  size  field
+//     0       4     "CCRP"
+//     4       2     format version
+//     6       2     rules version of the game, see CandyCrush::rulesVersion
+//     8       1     rows
+//     9       1     columns
+//     10      1     number of cell types
+//     11      1     reserved, always 0
+//     12      4     time limit in seconds
+//     16      8     seed
+//
+// A move record packs the index of the top or left cell of the swap (bits 0-5), whether the swap is downwards rather than
+// to the right (bit 6), whether the game accepted the move (bit 7) and the number of milliseconds since the game started
+// (bits 8-31, saturating). The number of moves follows from the file size, so a replay is valid after every move.
+namespace Replay {
+
+    static const uint16_t formatVersion = 1;
+    static const size_t headerSize = 24;
+    static const size_t moveSize = 4;
+
+    struct Move {
+        GameBoard::CellSwapMove move = GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 0));
+        bool wasAccepted = false;
+        uint32_t millisecondsSinceStart = 0;
+    };
+
+    // Records the moves of one game in memory, recording a move only appends four bytes to a buffer
+    class Writer {
+    public:
+        Writer(const CandyCrush& game);
+
+        // Call after every play on the game with what it returned. The move is stamped with the time the game judged it by, so
+        // a move the game accepted is always in time when the replay is verified. Swaps of cells that are not adjacent never
+        // change a game and are skipped.
+        void recordMove(const CandyCrush& game, GameBoard::CellSwapMove move, bool wasAccepted);
+
+        size_t numberOfMoves() const;
+        const std::vector<uint8_t>& getBytes() const;
+
+        // Returns false if the file could not be written
+        bool save(const std::string& path) const;
+
+    private:
+        std::vector<uint8_t> bytes;
+    };
+
+    // Read only view of a replay file mapped into memory, the moves are decoded when they are read
+    class Reader {
+    public:
+        ~Reader();
+
+        // Returns nullptr if the file can not be read, is not a replay or was recorded with a board or rules this game does not have
+        static std::unique_ptr<Reader> open(const std::string& path);
+
+        uint64_t getSeed() const;
+        int getTimeLimitInSeconds() const;
+        size_t numberOfMoves() const;
+        Move moveAt(size_t index) const;
+
+    private:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        Reader() {}
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+    };
+
+    struct VerificationResult {
+        long numberOfMoves = 0;
+        int score = 0;
+
+        // Index of the first move where the game did not accept or reject the move like the recorded game did, or -1
+        long firstMismatch = -1;
+
+        bool isValid() const {
+            return firstMismatch < 0;
+        }
+    };
+
+    // Plays all moves without any timing and checks that every move has the recorded outcome
+    VerificationResult verify(const Reader& reader);
+
+    // Game as it was after the given number of moves
+    CandyCrush fastForward(const Reader& reader, size_t numberOfMoves);
+}
+
+#endif /* Replay_hpp */
@@ -0,0 +1,57 @@
+// Command line front end for replays, it needs neither SDL nor a display.
+//
+// Build and run:
+//     clang++ -std=c++14 -O2 CandyCrush.cpp Trace.cpp Replay.cpp ReplayTool.cpp -o replay
+//     ./replay verify replay...
+//     ./replay show replay [moves]
+//
+// verify plays every replay as fast as possible and writes one JSON object per replay with its moves, score and whether
+// every move had the recorded outcome, followed by the total number of moves per second. show prints the board after the
+// given number of moves, or after all of them, which is where reproducing a reported bug starts.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "Replay.hpp"
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "verify" && argc > 2) {
+        long totalNumberOfMoves = 0;
+        auto numberOfInvalidReplays = 0;
+        auto startTime = std::chrono::steady_clock::now();
+        for (auto i = 2; i < argc; i++) {
+            auto reader = Replay::Reader::open(argv[i]);
+            if (reader == nullptr) {
+                std::cout << "{\"replay\": \"" << argv[i] << "\", \"error\": \"not a replay of this game\"}" << std::endl;
+                numberOfInvalidReplays++;
+                continue;
+            }
+            auto result = Replay::verify(*reader);
+            totalNumberOfMoves += result.numberOfMoves;
+            numberOfInvalidReplays += result.isValid() ? 0 : 1;
+            std::cout << "{\"replay\": \"" << argv[i] << "\""
+            << ", \"moves\": " << result.numberOfMoves
+            << ", \"score\": " << result.score
+            << ", \"valid\": " << (result.isValid() ? "true" : "false")
+            << ", \"firstMismatch\": " << result.firstMismatch
+            << "}" << std::endl;
+        }
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "{\"moves\": " << totalNumberOfMoves << ", \"movesPerSecond\": " << (long)(totalNumberOfMoves / seconds) << "}" << std::endl;
+        return numberOfInvalidReplays == 0 ? 0 : 1;
+    }
+    if (command == "show" && argc > 2) {
+        auto reader = Replay::Reader::open(argv[2]);
+        if (reader == nullptr) {
+            std::cerr << argv[2] << " is not a replay of this game" << std::endl;
+            return 1;
+        }
+        auto numberOfMoves = argc > 3 ? (size_t)std::stoul(argv[3]) : reader->numberOfMoves();
+        std::cout << "Seed: " << reader->getSeed() << ", moves: " << reader->numberOfMoves() << std::endl;
+        std::cout << Replay::fastForward(*reader, numberOfMoves);
+        return 0;
+    }
+    std::cerr << "Usage: replay verify replay... | replay show replay [moves]" << std::endl;
+    return 1;
+}
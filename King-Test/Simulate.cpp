@@ -0,0 +1,43 @@
+// Command line front end for the simulator, it needs neither SDL nor a display.
+//
+// Build and run:
+//     clang++ -std=c++14 -O2 -pthread CandyCrush.cpp Trace.cpp MonteCarloPlayer.cpp Simulator.cpp Simulate.cpp -o simulate
+//     ./simulate [games] [policy] [threads] [seed] [millisecondsPerMove]
+//
+// The policy is random, greedy, first or mcts. Games are played on a virtual clock where every move takes
+// millisecondsPerMove, 1000 by default, plus 250 milliseconds for every wave of matches it clears. Progress is written to stderr every second and the final statistics
+// are written to stdout as one JSON object.
+
+#include <iostream>
+#include <string>
+#include "Simulator.hpp"
+
+int main(int argc, char* argv[]) {
+    Simulator::Configuration configuration;
+    if (argc > 1) {
+        configuration.numberOfGames = std::stol(argv[1]);
+    }
+    if (argc > 2) {
+        configuration.policy = Simulator::policyNamed(argv[2]);
+        if (configuration.policy == nullptr) {
+            std::cerr << "Unknown policy " << argv[2] << ", expected random, greedy, first or mcts" << std::endl;
+            return 1;
+        }
+    }
+    if (argc > 3) {
+        configuration.numberOfThreads = (unsigned int)std::stoul(argv[3]);
+    }
+    if (argc > 4) {
+        configuration.seed = std::stoull(argv[4]);
+    }
+    if (argc > 5) {
+        configuration.clock = CandyCrush::Clock::virtualClock(std::stoi(argv[5]), configuration.clock.millisecondsPerWave);
+    }
+    configuration.progressCallback = [&](const Simulator::Statistics& statistics) {
+        std::cerr << statistics.numberOfGames << "/" << configuration.numberOfGames << " games" << std::endl;
+    };
+
+    auto statistics = Simulator::simulate(configuration);
+    statistics.print(std::cout);
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include "Simulator.hpp"
+#include "MonteCarloPlayer.hpp"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace Simulator {
+
+    GameBoard::CellSwapMove randomMove(const CandyCrush& game, RandomGenerator& randomGenerator) {
+        auto moves = game.legalMoves();
+        return moves[randomGenerator.nextBelow((uint32_t)moves.size())];
+    }
+
+    // Picks the move that gives the most score including its cascades. Every move is played with new cells from the same
+    // fixed seed, so the policy never sees the cells the game will actually get.
+    GameBoard::CellSwapMove greedyMove(const CandyCrush& game, RandomGenerator&) {
+        const uint64_t outcomeSeed = 0;
+        auto moves = game.legalMoves();
+        auto bestMove = moves.front();
+        auto bestScore = -1;
+        for (auto move: moves) {
+            auto score = game.outcomeForMove(move, outcomeSeed).getScore();
+            if (score > bestScore) {
+                bestScore = score;
+                bestMove = move;
+            }
+        }
+        return bestMove;
+    }
+
+    GameBoard::CellSwapMove firstLegalMove(const CandyCrush& game, RandomGenerator&) {
+        return game.legalMoves().front();
+    }
+
+    // Searches a fixed number of nodes on one thread, so the result only depends on the seed and the simulator keeps the cores busy.
+    // Every simulator thread keeps one player, so the arenas of its searches keep their blocks from one move to the next.
+    GameBoard::CellSwapMove monteCarloMove(const CandyCrush& game, RandomGenerator& randomGenerator) {
+        thread_local MonteCarloPlayer player([] {
+            MonteCarloPlayer::Configuration configuration;
+            configuration.maxNodes = 500;
+            configuration.timeBudget = std::chrono::seconds(10);
+            return configuration;
+        }());
+        player.setSeed(randomGenerator.next());
+        return player.search(game).bestMove;
+    }
+
+    MovePolicy policyNamed(const std::string& name) {
+        if (name == "random") {
+            return randomMove;
+        }
+        if (name == "greedy") {
+            return greedyMove;
+        }
+        if (name == "first") {
+            return firstLegalMove;
+        }
+        if (name == "mcts") {
+            return monteCarloMove;
+        }
+        return nullptr;
+    }
+
+    void Statistics::merge(const Statistics& statistics) {
+        numberOfGames += statistics.numberOfGames;
+        numberOfMoves += statistics.numberOfMoves;
+        numberOfDeadlocks += statistics.numberOfDeadlocks;
+        numberOfTimeouts += statistics.numberOfTimeouts;
+        totalScore += statistics.totalScore;
+        scores.merge(statistics.scores);
+        cascadeDepths.merge(statistics.cascadeDepths);
+    }
+
+    double Statistics::deadlockRate() const {
+        return numberOfGames > 0 ? (double)numberOfDeadlocks / numberOfGames : 0;
+    }
+
+    double Statistics::timeoutRate() const {
+        return numberOfGames > 0 ? (double)numberOfTimeouts / numberOfGames : 0;
+    }
+
+    void Statistics::print(std::ostream& os) const {
+        auto printHistogram = [&](const Histogram& histogram) {
+            os << "{\"bucketWidth\": " << histogram.bucketWidth << ", \"buckets\": [";
+            for (size_t i = 0; i < histogram.buckets.size(); i++) {
+                os << (i > 0 ? ", " : "") << histogram.buckets[i];
+            }
+            os << "]}";
+        };
+        os << "{\"games\": " << numberOfGames
+        << ", \"moves\": " << numberOfMoves
+        << ", \"averageScore\": " << (numberOfGames > 0 ? (double)totalScore / numberOfGames : 0)
+        << ", \"deadlockRate\": " << deadlockRate()
+        << ", \"timeoutRate\": " << timeoutRate()
+        << ", \"scores\": ";
+        printHistogram(scores);
+        os << ", \"cascadeDepths\": ";
+        printHistogram(cascadeDepths);
+        os << "}" << std::endl;
+    }
+
+    namespace {
+
+        // The games owned by one worker and the statistics of the games it has played so far.
+        // The owner takes games from the front of its range and idle workers steal the back half of what is left.
+        // The statistics have a mutex of their own, so that recording a move never waits for a thief.
+        struct WorkQueue {
+            std::mutex mutex;
+            long firstGame = 0;
+            long endGame = 0;
+            std::mutex statisticsMutex;
+            Statistics statistics;
+
+            bool takeGame(long& game) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (firstGame == endGame) {
+                    return false;
+                }
+                game = firstGame++;
+                return true;
+            }
+
+            // Moves the back half of the remaining games to the thief, returns false if there was nothing to steal
+            bool stealGames(WorkQueue& thief) {
+                long stolenFirstGame, stolenEndGame;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (firstGame == endGame) {
+                        return false;
+                    }
+                    stolenEndGame = endGame;
+                    stolenFirstGame = firstGame + (endGame-firstGame)/2;
+                    endGame = stolenFirstGame;
+                }
+                std::lock_guard<std::mutex> lock(thief.mutex);
+                thief.firstGame = stolenFirstGame;
+                thief.endGame = stolenEndGame;
+                return true;
+            }
+        };
+
+        // Adds the moves and the result of the game straight to the statistics of the worker, so a game allocates nothing for them
+        void simulateGame(long gameNumber, const Configuration& configuration, WorkQueue& queue) {
+            RandomGenerator randomGenerator(configuration.seed + (uint64_t)gameNumber);
+            CandyCrush game(randomGenerator.next(), configuration.clock);
+            for (auto i = 0; i < configuration.maxMovesPerGame && !game.gameOver(); i++) {
+                game.play(configuration.policy(game, randomGenerator));
+                std::lock_guard<std::mutex> lock(queue.statisticsMutex);
+                queue.statistics.numberOfMoves++;
+                queue.statistics.cascadeDepths.add(game.getNumberOfCascadesInLastMove());
+            }
+            std::lock_guard<std::mutex> lock(queue.statisticsMutex);
+            queue.statistics.numberOfGames++;
+            queue.statistics.numberOfDeadlocks += game.hasLegalMoves() ? 0 : 1;
+            queue.statistics.numberOfTimeouts += game.numberOfSecondsLeft() <= 0 ? 1 : 0;
+            queue.statistics.totalScore += game.getScore();
+            queue.statistics.scores.add(game.getScore());
+        }
+
+        void runWorker(size_t workerIndex, std::vector<std::unique_ptr<WorkQueue>>& queues, const Configuration& configuration) {
+            auto& queue = *queues[workerIndex];
+            while (true) {
+                long gameNumber;
+                while (queue.takeGame(gameNumber)) {
+                    simulateGame(gameNumber, configuration, queue);
+                }
+
+                // Games are never added, so when no other worker has anything left to steal all work is done or being done
+                auto didSteal = false;
+                for (size_t i = 1; i < queues.size() && !didSteal; i++) {
+                    didSteal = queues[(workerIndex+i) % queues.size()]->stealGames(queue);
+                }
+                if (!didSteal) {
+                    return;
+                }
+            }
+        }
+    }
+
+    Statistics simulate(const Configuration& configuration) {
+        auto numberOfThreads = std::max(configuration.numberOfThreads, 1u);
+
+        // Every worker starts with an equal share of the games
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        for (unsigned int i = 0; i < numberOfThreads; i++) {
+            queues.emplace_back(new WorkQueue());
+            queues.back()->firstGame = configuration.numberOfGames * i / numberOfThreads;
+            queues.back()->endGame = configuration.numberOfGames * (i+1) / numberOfThreads;
+        }
+
+        std::mutex finishedMutex;
+        std::condition_variable finishedCondition;
+        unsigned int numberOfFinishedWorkers = 0;
+
+        std::vector<std::thread> workers;
+        for (unsigned int i = 0; i < numberOfThreads; i++) {
+            workers.emplace_back([&, i] {
+                runWorker(i, queues, configuration);
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                numberOfFinishedWorkers++;
+                finishedCondition.notify_one();
+            });
+        }
+
+        auto collectStatistics = [&] {
+            Statistics statistics;
+            for (auto& queue: queues) {
+                std::lock_guard<std::mutex> lock(queue->statisticsMutex);
+                statistics.merge(queue->statistics);
+            }
+            return statistics;
+        };
+
+        {
+            std::unique_lock<std::mutex> lock(finishedMutex);
+            auto nextProgressTime = std::chrono::steady_clock::now() + configuration.progressInterval;
+            while (numberOfFinishedWorkers < numberOfThreads) {
+                auto status = finishedCondition.wait_until(lock, nextProgressTime);
+                if (status == std::cv_status::timeout && numberOfFinishedWorkers < numberOfThreads) {
+                    nextProgressTime += configuration.progressInterval;
+                    if (configuration.progressCallback != nullptr) {
+                        lock.unlock();
+                        configuration.progressCallback(collectStatistics());
+                        lock.lock();
+                    }
+                }
+            }
+        }
+
+        for (auto& worker: workers) {
+            worker.join();
+        }
+        return collectStatistics();
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef Simulator_hpp
+#define Simulator_hpp
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CandyCrush.hpp"
+
+// Plays many seeded games without any user interface, spread over all cores, and only keeps aggregate statistics.
+// Used offline to tune scoring and difficulty with scripted move policies.
+namespace Simulator {
+
+    // Picks the next move in a game that is not over. The generator belongs to the simulated game so random choices are reproducible.
+    typedef std::function<GameBoard::CellSwapMove(const CandyCrush&, RandomGenerator&)> MovePolicy;
+
+    GameBoard::CellSwapMove randomMove(const CandyCrush& game, RandomGenerator& randomGenerator);
+    GameBoard::CellSwapMove greedyMove(const CandyCrush& game, RandomGenerator& randomGenerator);
+    GameBoard::CellSwapMove firstLegalMove(const CandyCrush& game, RandomGenerator& randomGenerator);
+    GameBoard::CellSwapMove monteCarloMove(const CandyCrush& game, RandomGenerator& randomGenerator);
+
+    // Returns the policy with the given name (random, greedy, first or mcts) or nullptr if there is no such policy
+    MovePolicy policyNamed(const std::string& name);
+
+    // Counts values in buckets of equal width, the last bucket also counts every value above the range
+    struct Histogram {
+        long bucketWidth;
+        std::vector<long> buckets;
+
+        Histogram(long bucketWidth, size_t numberOfBuckets): bucketWidth(bucketWidth), buckets(numberOfBuckets, 0) {}
+
+        void add(long value) {
+            auto bucket = std::min((size_t)(std::max(value, 0L) / bucketWidth), buckets.size()-1);
+            buckets[bucket]++;
+        }
+
+        void merge(const Histogram& histogram) {
+            for (size_t i = 0; i < buckets.size(); i++) {
+                buckets[i] += histogram.buckets[i];
+            }
+        }
+    };
+
+    struct Statistics {
+        long numberOfGames = 0;
+        long numberOfMoves = 0;
+        long numberOfDeadlocks = 0;
+        long numberOfTimeouts = 0;
+        long totalScore = 0;
+        Histogram scores = Histogram(25, 40);
+
+        // Number of cascades after each move
+        Histogram cascadeDepths = Histogram(1, 16);
+
+        void merge(const Statistics& statistics);
+
+        // Fraction of games that ended because there were no legal moves left
+        double deadlockRate() const;
+
+        // Fraction of games that ended because the time ran out
+        double timeoutRate() const;
+
+        // Writes the statistics as a single JSON object
+        void print(std::ostream& os) const;
+    };
+
+    struct Configuration {
+        long numberOfGames = 1000;
+
+        // Games end when they run out of moves or time, or after this many moves
+        int maxMovesPerGame = 100;
+
+        // Games are played on this clock, by default a virtual clock where a move takes a second plus a quarter of a second for
+        // every wave of matches it clears, about what a player takes with the animations in the window
+        CandyCrush::Clock clock = CandyCrush::Clock::virtualClock(1000, 250);
+
+        // Game number i is played with seeds derived from seed + i, so the same configuration always gives the same statistics
+        uint64_t seed = 1;
+
+        unsigned int numberOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        MovePolicy policy = randomMove;
+
+        // Called on the calling thread with the statistics of all games finished so far, the move counts also include the moves
+        // of the games that are still being played
+        std::function<void(const Statistics&)> progressCallback = nullptr;
+        std::chrono::milliseconds progressInterval = std::chrono::milliseconds(1000);
+    };
+
+    // Blocks until all games have been played and returns their combined statistics
+    Statistics simulate(const Configuration& configuration);
+}
+
+#endif /* Simulator_hpp */
@@ -0,0 +1,746 @@
+// Regression tests for the game logic, they need neither SDL nor a display and are not part of the Xcode target since they
+// have their own main function.
+//
+// Build and run:
+//     clang++ -std=c++14 -O2 -pthread CandyCrush.cpp Trace.cpp Replay.cpp HugeBoard.cpp BoardShapes.cpp Tests.cpp -o tests
+//     ./tests
+//
+// Every failed check is printed, the exit status is the number of failed checks.
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BoardShapes.hpp"
+#include "CandyCrush.hpp"
+#include "HugeBoard.hpp"
+#include "Replay.hpp"
+#include "TranspositionTable.hpp"
+
+struct CandyCrushTests {
+
+    static void clearAllMatches(CandyCrush& game) {
+        game.clearAllMatches(CandyCrush::NoCallback());
+    }
+};
+
+struct HugeBoardGameTests {
+
+    // Sets the cell and marks its tile as changed, as a move would
+    static void setCell(HugeBoardGame& game, size_t row, size_t column, uint8_t cellType) {
+        *game.cellPointer(row, column) = cellType;
+        game.markChangedCell(GameBoard::CellPosition((int)row, (int)column));
+    }
+
+    // Runs the passes that find the matches of a cascade, without letting any cells fall
+    static void markMatches(HugeBoardGame& game) {
+        game.scanAroundChangedTiles();
+        game.markHorizontalMatches();
+        game.markVerticalMatches();
+    }
+
+    static bool isMatched(const HugeBoardGame& game, size_t row, size_t column) {
+        return (*game.cellPointer(row, column) & HugeBoardGame::matchedFlag) != 0;
+    }
+
+    static bool hasWorkerPool(const HugeBoardGame& game) {
+        return game.workerPool != nullptr;
+    }
+};
+
+namespace {
+
+    int numberOfFailedChecks = 0;
+
+    void check(bool isPassing, const char* description) {
+        if (!isPassing) {
+            std::cout << "FAILED: " << description << std::endl;
+            numberOfFailedChecks++;
+        }
+    }
+
+    typedef CandyCrush::CandyCrushBitboard Bitboard;
+
+    std::vector<size_t> runLengths(Bitboard::Mask matches, size_t step) {
+        std::vector<size_t> lengths;
+        Bitboard::forEachRun(matches, step, [&](size_t length) {
+            lengths.push_back(length);
+        });
+        return lengths;
+    }
+
+    Bitboard::Mask cells(std::initializer_list<GameBoard::CellPosition> positions) {
+        Bitboard::Mask mask = 0;
+        for (auto position: positions) {
+            mask |= Bitboard::cellMask(position);
+        }
+        return mask;
+    }
+
+    void testRunsEndAtRowBoundary() {
+        using GameBoard::CellPosition;
+        auto matches = cells({CellPosition(0, 5), CellPosition(0, 6), CellPosition(0, 7), CellPosition(1, 0), CellPosition(1, 1), CellPosition(1, 2)});
+        check(runLengths(matches, 1) == std::vector<size_t>({3, 3}), "a horizontal run at the end of a row and one at the start of the next are two runs");
+
+        auto lastRows = cells({CellPosition(6, 6), CellPosition(6, 7), CellPosition(7, 0), CellPosition(7, 1), CellPosition(7, 2), CellPosition(7, 3)});
+        check(runLengths(lastRows, 1) == std::vector<size_t>({2, 4}), "runs are split at the boundary of the last two rows");
+
+        auto column = cells({CellPosition(0, 7), CellPosition(1, 7), CellPosition(2, 7), CellPosition(3, 0)});
+        check(runLengths(column, CandyCrush::CandyCrushGameBoard::columns) == std::vector<size_t>({3, 1}), "vertical runs stay in their column");
+    }
+
+    // Unpacks a game with the given cells, all other state comes from a seeded game
+    template<typename Game, size_t ROWS, size_t COLUMNS>
+    Game gameWithCells(const typename Game::Cell (&gameBoard)[ROWS][COLUMNS]) {
+        auto state = Game(1).pack();
+        for (auto& bits: state.cellTypeBits) {
+            bits = 0;
+        }
+        for (size_t row = 0; row < ROWS; row++) {
+            for (size_t column = 0; column < COLUMNS; column++) {
+                for (size_t i = 0; i < Game::PackedState::numberOfCellTypeBits; i++) {
+                    if ((gameBoard[row][column] >> i) & 1) {
+                        state.cellTypeBits[i] |= Game::CandyCrushBitboard::cellMask(GameBoard::CellPosition((int)row, (int)column));
+                    }
+                }
+            }
+        }
+        return Game(state);
+    }
+
+    void testWaveCountsRunsAcrossRowBoundary() {
+
+        // No two neighbours have the same type, except for the runs at the end of row 0 and the start of row 1
+        CandyCrush::Cell gameBoard[8][8];
+        for (auto row = 0; row < 8; row++) {
+            for (auto column = 0; column < 8; column++) {
+                gameBoard[row][column] = (CandyCrush::Cell)((row + 2*column) % CandyCrush::numberOfCellTypes);
+            }
+        }
+        for (auto column: {5, 6, 7}) {
+            gameBoard[0][column] = CandyCrush::Blue;
+        }
+        for (auto column: {0, 1, 2}) {
+            gameBoard[1][column] = CandyCrush::Blue;
+        }
+        auto game = gameWithCells<CandyCrush>(gameBoard);
+        CandyCrushTests::clearAllMatches(game);
+        auto& waves = game.getCascadeWavesInLastMove();
+        check(!waves.empty() && waves[0].numberOfRuns == 2, "the first wave counts the runs at the end of a row and the start of the next as two runs");
+        check(!waves.empty() && waves[0].numberOfRemovedCells == 6, "the first wave removes both runs");
+    }
+
+    // The cascade loop from before moves were cleared in waves, written cell by cell: every pass scans the whole board, removes
+    // every cell of a run of 3 or more once, lets the cells above fall and refills each column from the top, column by column,
+    // until a pass finds no match. It starts from the cells and generator of a game.
+    struct ReferenceGame {
+        int cells[8][8];
+        RandomGenerator randomGenerator;
+        int score;
+        std::vector<int> removedCellsPerWave;
+
+        ReferenceGame(const CandyCrush& game): randomGenerator(game.pack().randomGenerator), score(game.getScore()) {
+            for (auto row = 0; row < 8; row++) {
+                for (auto column = 0; column < 8; column++) {
+                    cells[row][column] = game.getGameBoard()[row][column];
+                }
+            }
+        }
+
+        bool clearMatches() {
+            bool isMatched[8][8] = {};
+            auto numberOfRemovedCells = 0;
+            auto markRuns = [&](int rowStep, int columnStep) {
+                for (auto line = 0; line < 8; line++) {
+                    auto start = 0;
+                    for (auto i = 1; i <= 8; i++) {
+                        auto cellAt = [&](int index) {
+                            return rowStep == 0 ? cells[line][index] : cells[index][line];
+                        };
+                        if (i < 8 && cellAt(i) == cellAt(start)) {
+                            continue;
+                        }
+                        if (i - start >= 3) {
+                            score += i - start;
+                            for (auto j = start; j < i; j++) {
+                                auto& matched = rowStep == 0 ? isMatched[line][j] : isMatched[j][line];
+                                numberOfRemovedCells += !matched;
+                                matched = true;
+                            }
+                        }
+                        start = i;
+                    }
+                }
+            };
+            markRuns(0, 1);
+            markRuns(1, 0);
+            if (numberOfRemovedCells == 0) {
+                return false;
+            }
+            removedCellsPerWave.push_back(numberOfRemovedCells);
+            for (auto column = 0; column < 8; column++) {
+                auto newRow = 7;
+                for (auto row = 7; row >= 0; row--) {
+                    if (!isMatched[row][column]) {
+                        cells[newRow--][column] = cells[row][column];
+                    }
+                }
+                for (auto row = 0; row <= newRow; row++) {
+                    cells[row][column] = (int)randomGenerator.nextBelow(CandyCrush::numberOfCellTypes);
+                }
+            }
+            return true;
+        }
+
+        void play(GameBoard::CellSwapMove move) {
+            std::swap(cells[move.from.row][move.from.column], cells[move.to.row][move.to.column]);
+            removedCellsPerWave.clear();
+            while (clearMatches()) {}
+        }
+
+        bool hasCells(const CandyCrush& game) const {
+            for (auto row = 0; row < 8; row++) {
+                for (auto column = 0; column < 8; column++) {
+                    if (cells[row][column] != game.getGameBoard()[row][column]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    };
+
+    // Seeded games played with the waves end every move with the cells, score and waves of the cell by cell loop
+    void testWavesMatchReferenceLoop() {
+        auto isSameGame = true;
+        auto numberOfLongCascades = 0;
+        for (uint64_t seed = 1; seed <= 200; seed++) {
+            CandyCrush game(seed, CandyCrush::Clock::virtualClock(0));
+            RandomGenerator randomGenerator(seed);
+            for (auto i = 0; i < 50 && game.hasLegalMoves(); i++) {
+                auto moves = game.legalMoves();
+                auto move = moves[randomGenerator.nextBelow((uint32_t)moves.size())];
+                ReferenceGame referenceGame(game);
+                referenceGame.play(move);
+                game.play(move);
+
+                auto& waves = game.getCascadeWavesInLastMove();
+                auto isSameWaves = referenceGame.removedCellsPerWave.size() == (size_t)(1 + game.getNumberOfCascadesInLastMove());
+                for (size_t wave = 0; wave < waves.size() && isSameWaves; wave++) {
+                    isSameWaves = waves[wave].numberOfRemovedCells == referenceGame.removedCellsPerWave[wave];
+                }
+                isSameGame = isSameGame && isSameWaves && referenceGame.hasCells(game) && referenceGame.score == game.getScore();
+                numberOfLongCascades += game.getNumberOfCascadesInLastMove() >= 3;
+            }
+        }
+        check(isSameGame, "moves cleared in waves give the cells, score and waves of the cell by cell loop");
+        check(numberOfLongCascades > 10, "moves with cascades of four or more waves are compared");
+    }
+
+    // Runs that share a cell (L, T and cross shapes) score as two runs but the shared cell is only removed once
+    void testIntersectingMatchesAreRemovedOnce() {
+
+        // No cell is Blue except for the shapes, and no two neighbours have the same type
+        const CandyCrush::Cell otherCells[] = {CandyCrush::Green, CandyCrush::Purple, CandyCrush::Red, CandyCrush::Yellow};
+        CandyCrush::Cell gameBoard[8][8];
+        for (auto row = 0; row < 8; row++) {
+            for (auto column = 0; column < 8; column++) {
+                gameBoard[row][column] = otherCells[(row + 2*column) % 4];
+            }
+        }
+        auto addShape = [&](std::initializer_list<GameBoard::CellPosition> positions) {
+            for (auto position: positions) {
+                gameBoard[position.row][position.column] = CandyCrush::Blue;
+            }
+        };
+        using GameBoard::CellPosition;
+        addShape({CellPosition(0, 0), CellPosition(1, 0), CellPosition(2, 0), CellPosition(2, 1), CellPosition(2, 2)});
+        addShape({CellPosition(1, 6), CellPosition(2, 5), CellPosition(2, 6), CellPosition(2, 7), CellPosition(3, 6)});
+        addShape({CellPosition(5, 3), CellPosition(5, 4), CellPosition(5, 5), CellPosition(6, 4), CellPosition(7, 4)});
+        auto game = gameWithCells<CandyCrush>(gameBoard);
+        CandyCrushTests::clearAllMatches(game);
+        auto& waves = game.getCascadeWavesInLastMove();
+        check(!waves.empty() && waves[0].numberOfRuns == 6, "an L, a cross and a T are two runs each");
+        check(!waves.empty() && waves[0].numberOfRemovedCells == 15, "the cells shared by two runs are removed once");
+        check(!waves.empty() && waves[0].score == 18, "every run of three scores three");
+    }
+
+    // Fills the board with the cell types other than Blue and Red, without two neighbours of the same type
+    template<typename Game, size_t ROWS, size_t COLUMNS>
+    void fillWithoutMatches(typename Game::Cell (&gameBoard)[ROWS][COLUMNS]) {
+        std::vector<typename Game::Cell> otherCells;
+        for (size_t cellType = 0; cellType < Game::numberOfCellTypes; cellType++) {
+            if (cellType != Game::Blue && cellType != Game::Red) {
+                otherCells.push_back((typename Game::Cell)cellType);
+            }
+        }
+        for (size_t row = 0; row < ROWS; row++) {
+            for (size_t column = 0; column < COLUMNS; column++) {
+                gameBoard[row][column] = otherCells[(row + column) % otherCells.size()];
+            }
+        }
+    }
+
+    template<typename Cell, size_t ROWS, size_t COLUMNS>
+    void setCells(Cell (&gameBoard)[ROWS][COLUMNS], std::initializer_list<GameBoard::CellPosition> positions, Cell cell) {
+        for (auto position: positions) {
+            gameBoard[position.row][position.column] = cell;
+        }
+    }
+
+    // Plays the move and checks the wave of it that removes the shape. The wave must remove the shape and nothing else, let every
+    // cell above it fall down by the number of removed cells below it and refill the top of the columns.
+    template<typename Game, size_t ROWS, size_t COLUMNS>
+    void checkShapeFallsAfterMove(const std::string& shapeName, const typename Game::Cell (&gameBoard)[ROWS][COLUMNS], GameBoard::CellSwapMove move, size_t wave, std::initializer_list<GameBoard::CellPosition> shape) {
+        auto game = gameWithCells<Game>(gameBoard);
+        check(typename Game::CandyCrushBitboard(game.getGameBoard()).matchedCells() == 0, (shapeName + " has no matches before the move").c_str());
+
+        // The first change is the swap and every change after it is a wave
+        size_t numberOfChanges = 0;
+        std::vector<std::pair<int, int>> removedCells;
+        auto boardBeforeWave = game.getGameBoard();
+        auto boardAfterWave = game.getGameBoard();
+        auto isMoveValid = game.play(move, [&](const typename Game::GameBoardChange& gameBoardChange) {
+            numberOfChanges++;
+            if (numberOfChanges == wave + 1) {
+                boardBeforeWave = game.getGameBoard();
+            } else if (numberOfChanges == wave + 2) {
+                for (const auto& removedCell: gameBoardChange.removedCells) {
+                    removedCells.push_back(std::make_pair(removedCell.row, removedCell.column));
+                }
+                boardAfterWave = game.getGameBoard();
+            }
+        });
+        check(isMoveValid, (shapeName + " is made by a legal move").c_str());
+
+        std::vector<std::pair<int, int>> shapeCells;
+        for (auto position: shape) {
+            shapeCells.push_back(std::make_pair(position.row, position.column));
+        }
+        std::sort(removedCells.begin(), removedCells.end());
+        std::sort(shapeCells.begin(), shapeCells.end());
+        check(removedCells == shapeCells, (shapeName + " is removed and nothing else").c_str());
+
+        auto hasFallen = true;
+        for (auto column = 0; column < (int)COLUMNS; column++) {
+            auto newRow = (int)ROWS - 1;
+            for (auto row = (int)ROWS - 1; row >= 0; row--) {
+                if (std::find(shapeCells.begin(), shapeCells.end(), std::make_pair(row, column)) == shapeCells.end()) {
+                    hasFallen = hasFallen && boardAfterWave[newRow][column] == boardBeforeWave[row][column];
+                    newRow--;
+                }
+            }
+            for (; newRow >= 0; newRow--) {
+                hasFallen = hasFallen && boardAfterWave[newRow][column] < Game::numberOfCellTypes;
+            }
+        }
+        check(hasFallen, (shapeName + " lets the cells above it fall down and the columns are refilled from the top").c_str());
+
+        auto& waves = game.getCascadeWavesInLastMove();
+        auto isWaveCounted = waves.size() > wave && waves[wave].numberOfRuns == 2 && waves[wave].numberOfRemovedCells == shape.size() && waves[wave].score == 6;
+        check(isWaveCounted, (shapeName + " is two runs of three that share a cell").c_str());
+    }
+
+    // Boards of other sizes play on the same engine, the 9x9 and 10x10 boards need masks of more than 64 bits. A swap can only
+    // make an L or a T, a cross is made by the cells that fall down after the first wave.
+    void testShapesFallOnOtherBoards() {
+        using GameBoard::CellPosition;
+        using GameBoard::CellSwapMove;
+
+        typedef CandyCrushGame<6, 6, 4> SmallGame;
+        SmallGame::Cell smallBoard[6][6];
+        fillWithoutMatches<SmallGame>(smallBoard);
+        setCells(smallBoard, {CellPosition(1, 0), CellPosition(2, 0), CellPosition(4, 0), CellPosition(3, 1), CellPosition(3, 2)}, SmallGame::Blue);
+        checkShapeFallsAfterMove<SmallGame>("an L on a 6x6 board", smallBoard, CellSwapMove(CellPosition(4, 0), CellPosition(3, 0)), 0,
+            {CellPosition(1, 0), CellPosition(2, 0), CellPosition(3, 0), CellPosition(3, 1), CellPosition(3, 2)});
+
+        typedef CandyCrushGame<9, 9, 6> MediumGame;
+        MediumGame::Cell mediumBoard[9][9];
+        fillWithoutMatches<MediumGame>(mediumBoard);
+        setCells(mediumBoard, {CellPosition(4, 3), CellPosition(3, 4), CellPosition(4, 5), CellPosition(5, 4), CellPosition(6, 4)}, MediumGame::Blue);
+        checkShapeFallsAfterMove<MediumGame>("a T on a 9x9 board", mediumBoard, CellSwapMove(CellPosition(3, 4), CellPosition(4, 4)), 0,
+            {CellPosition(4, 3), CellPosition(4, 4), CellPosition(4, 5), CellPosition(5, 4), CellPosition(6, 4)});
+
+        // The move matches three Blue cells in column 5, the two Red cells above them fall down onto the Red cell below them
+        // in the middle of a Red row
+        typedef CandyCrushGame<10, 10, 7> LargeGame;
+        LargeGame::Cell largeBoard[10][10];
+        fillWithoutMatches<LargeGame>(largeBoard);
+        setCells(largeBoard, {CellPosition(4, 5), CellPosition(5, 5), CellPosition(9, 5), CellPosition(8, 4), CellPosition(8, 6)}, LargeGame::Red);
+        setCells(largeBoard, {CellPosition(7, 5), CellPosition(8, 5), CellPosition(6, 6)}, LargeGame::Blue);
+        checkShapeFallsAfterMove<LargeGame>("a cross on a 10x10 board", largeBoard, CellSwapMove(CellPosition(6, 6), CellPosition(6, 5)), 1,
+            {CellPosition(7, 5), CellPosition(8, 4), CellPosition(8, 5), CellPosition(8, 6), CellPosition(9, 5)});
+    }
+
+    // Every adjacent swap in both directions that leaves a match after swapping the cells and scanning the whole board
+    template<typename Game>
+    std::vector<std::pair<GameBoard::CellPosition, GameBoard::CellPosition>> bruteForceLegalMoves(const Game& game) {
+        std::vector<std::pair<GameBoard::CellPosition, GameBoard::CellPosition>> moves;
+        auto& gameBoard = game.getGameBoard();
+        for (auto row = 0; row < (int)gameBoard.rows; row++) {
+            for (auto column = 0; column < (int)gameBoard.columns; column++) {
+                GameBoard::CellPosition cell(row, column);
+                for (auto adjacentCell: gameBoard.adjacentCells(cell)) {
+                    auto swappedBoard = gameBoard;
+                    swappedBoard.swapCells(cell, adjacentCell);
+                    if (typename Game::CandyCrushBitboard(swappedBoard).matchedCells() != 0) {
+                        moves.push_back(std::make_pair(cell, adjacentCell));
+                    }
+                }
+            }
+        }
+        return moves;
+    }
+
+    template<typename Game>
+    bool hasBruteForceLegalMoves(const Game& game) {
+        std::vector<std::pair<GameBoard::CellPosition, GameBoard::CellPosition>> moves;
+        for (const auto& move: game.legalMoves()) {
+            moves.push_back(std::make_pair(move.from, move.to));
+        }
+        return moves == bruteForceLegalMoves(game) && game.hasLegalMoves() == !moves.empty();
+    }
+
+    // The local check only looks two cells away from the swapped cells, a swap on a board without matches must create a match
+    // exactly when the whole board has one after actually swapping
+    void testSwapCreatesMatchAgreesWithSwapping() {
+        auto isCheckCorrect = true;
+        auto numberOfSwapsCreatingMatch = 0;
+        for (uint64_t seed = 1; seed <= 500; seed++) {
+            CandyCrush game(seed);
+            auto& gameBoard = game.getGameBoard();
+            for (auto row = 0; row < (int)gameBoard.rows; row++) {
+                for (auto column = 0; column < (int)gameBoard.columns; column++) {
+                    GameBoard::CellPosition cell(row, column);
+                    for (auto adjacentCell: gameBoard.adjacentCells(cell)) {
+                        auto swappedBoard = gameBoard;
+                        swappedBoard.swapCells(cell, adjacentCell);
+                        auto createsMatch = gameBoard.swapCreatesMatch(GameBoard::CellSwapMove(cell, adjacentCell));
+                        isCheckCorrect = isCheckCorrect && createsMatch == (Bitboard(swappedBoard).matchedCells() != 0);
+                        numberOfSwapsCreatingMatch += createsMatch;
+                    }
+                }
+            }
+        }
+        check(isCheckCorrect, "a swap creates a match exactly when the board has a match after swapping");
+        check(numberOfSwapsCreatingMatch > 0, "some of the swaps checked create a match");
+
+        CandyCrush game(1);
+        auto& gameBoard = game.getGameBoard();
+        check(!gameBoard.swapCreatesMatch(GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 2))), "cells that are not adjacent can not be swapped");
+        check(!gameBoard.swapCreatesMatch(GameBoard::CellSwapMove(GameBoard::CellPosition(0, 7), GameBoard::CellPosition(0, 8))), "cells outside the board can not be swapped");
+    }
+
+    // The index is checked on new boards, which have had their matches cleared, and after every move of seeded games, many of
+    // which end in cascades of several waves
+    void testLegalMovesMatchBruteForce() {
+        auto isIndexCorrect = true;
+        auto numberOfMovesWithCascades = 0;
+        for (uint64_t seed = 1; seed <= 200; seed++) {
+            CandyCrush game(seed, CandyCrush::Clock::virtualClock(0));
+            isIndexCorrect = isIndexCorrect && hasBruteForceLegalMoves(game);
+            RandomGenerator randomGenerator(seed);
+            for (auto i = 0; i < 50 && game.hasLegalMoves(); i++) {
+                auto moves = game.legalMoves();
+                game.play(moves[randomGenerator.nextBelow((uint32_t)moves.size())]);
+                numberOfMovesWithCascades += game.getNumberOfCascadesInLastMove() >= 2;
+                isIndexCorrect = isIndexCorrect && hasBruteForceLegalMoves(game);
+            }
+        }
+        check(isIndexCorrect, "the legal moves are the swaps that create a match");
+        check(numberOfMovesWithCascades > 100, "the legal moves are checked after moves with cascades of several waves");
+    }
+
+    template<typename Game>
+    bool hasBruteForceLegalMovesAfterMoves(uint64_t seed) {
+        Game game(seed, Game::Clock::virtualClock(0));
+        auto isIndexCorrect = hasBruteForceLegalMoves(game);
+        RandomGenerator randomGenerator(seed);
+        for (auto i = 0; i < 30 && game.hasLegalMoves(); i++) {
+            auto moves = game.legalMoves();
+            game.play(moves[randomGenerator.nextBelow((uint32_t)moves.size())]);
+            isIndexCorrect = isIndexCorrect && hasBruteForceLegalMoves(game);
+        }
+        return isIndexCorrect;
+    }
+
+    void testShapeLegalMovesMatchBruteForce() {
+        auto isIndexCorrect = true;
+        for (uint64_t seed = 1; seed <= 20; seed++) {
+            isIndexCorrect = isIndexCorrect && hasBruteForceLegalMovesAfterMoves<CandyCrushGame<6, 6, 4>>(seed);
+            isIndexCorrect = isIndexCorrect && hasBruteForceLegalMovesAfterMoves<CandyCrushGame<9, 9, 6>>(seed);
+            isIndexCorrect = isIndexCorrect && hasBruteForceLegalMovesAfterMoves<CandyCrushGame<10, 10, 7>>(seed);
+        }
+        check(isIndexCorrect, "the legal moves on other board sizes are the swaps that create a match");
+
+        auto shapeGame = BoardShapeGame::make(10, 10, 7, 3);
+        check(shapeGame != nullptr && shapeGame->rows() == 10 && shapeGame->columns() == 10 && shapeGame->numberOfCellTypes() == 7, "a supported shape is made with its size");
+        check(BoardShapeGame::make(7, 7, 5, 3) == nullptr && BoardShapeGame::make(8, 8, 3, 3) == nullptr, "unsupported shapes are not made");
+        if (shapeGame != nullptr) {
+            auto moves = shapeGame->legalMoves();
+            auto copy = shapeGame->copy();
+            auto isPlayed = !moves.empty() && shapeGame->play(moves.front()) && shapeGame->getScore() >= 3;
+            check(isPlayed, "a legal move on a shape scores");
+            check(copy->getScore() == 0, "a copy of a shape game is not changed by moves on the original");
+        }
+    }
+
+    // Moves are stamped with the time the game judged them by, so the last move in time is also in time when it is verified
+    void testReplayOfMovesAtTheTimeLimit() {
+        CandyCrush game(7, CandyCrush::Clock::virtualClock(29999));
+        Replay::Writer writer(game);
+        while (!game.gameOver()) {
+            auto move = game.legalMoves().front();
+            writer.recordMove(game, move, game.play(move));
+        }
+        auto move = GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 1));
+        writer.recordMove(game, move, game.play(move));
+        check(writer.numberOfMoves() == 4, "moves at 0, 29999 and 59998 milliseconds are played and the one after them is recorded");
+
+        auto path = "tests.replay";
+        writer.save(path);
+        auto reader = Replay::Reader::open(path);
+        check(reader != nullptr && reader->moveAt(2).millisecondsSinceStart == 59998 && reader->moveAt(2).wasAccepted, "the last move in time is stamped with the time of the game");
+        check(reader != nullptr && Replay::verify(*reader).isValid(), "a replay with moves right before the time limit verifies");
+        std::remove(path);
+    }
+
+    // A record stores the cell index of the top or left cell, a swap with a cell off the board has no index to store
+    void testReplayIgnoresMovesOffTheBoard() {
+        using GameBoard::CellPosition;
+        using GameBoard::CellSwapMove;
+        CandyCrush game(7, CandyCrush::Clock::virtualClock(0));
+        Replay::Writer writer(game);
+        for (auto move: {CellSwapMove(CellPosition(0, 0), CellPosition(-1, 0)), CellSwapMove(CellPosition(7, 7), CellPosition(7, 8)),
+                         CellSwapMove(CellPosition(0, -1), CellPosition(0, 0)), CellSwapMove(CellPosition(8, 3), CellPosition(7, 3))}) {
+            writer.recordMove(game, move, game.play(move));
+        }
+        check(writer.numberOfMoves() == 0, "moves with a cell off the board are not recorded");
+
+        auto move = game.legalMoves().front();
+        writer.recordMove(game, move, game.play(move));
+        check(writer.numberOfMoves() == 1, "a move on the board is recorded after moves off the board");
+    }
+
+    // A virtual clock charges an accepted move for the wave it created and for every cascade after it
+    void testVirtualClockChargesEveryWave() {
+        CandyCrush game(7, CandyCrush::Clock::virtualClock(1000, 250));
+        auto illegalMove = GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 2));
+        game.play(illegalMove);
+        game.play(illegalMove);
+        check(game.getNumberOfMillisecondsElapsedInLastMove() == 1000, "a rejected move is charged for the move only");
+
+        game.play(game.legalMoves().front());
+        auto numberOfWaves = (long)game.getCascadeWavesInLastMove().size();
+        auto numberOfCascades = game.getNumberOfCascadesInLastMove();
+        game.play(illegalMove);
+        check(numberOfWaves == 1 + numberOfCascades, "the waves of a move are its first wave and its cascades");
+        check(game.getNumberOfMillisecondsElapsedInLastMove() == 2000 + 1000 + 250*numberOfWaves, "an accepted move is charged for every wave it cleared");
+
+        // The elapsed time is read by playing a rejected move on a copy, which stamps the time before charging for itself
+        auto elapsedTime = [&](CandyCrush game) {
+            game.play(illegalMove);
+            return game.getNumberOfMillisecondsElapsedInLastMove();
+        };
+        while (game.getNumberOfCascadesInLastMove() == 0 && game.hasLegalMoves()) {
+            game.play(game.legalMoves().front());
+        }
+        check(game.getNumberOfCascadesInLastMove() > 0, "a move with cascades is found");
+        auto outcome = game.outcomeForMove(illegalMove, 1);
+        check(elapsedTime(outcome) == elapsedTime(game) + 1000, "a rejected outcome is not charged for the cascades of the move before it");
+        auto move = game.legalMoves().front();
+        outcome = game.outcomeForMove(move, 1);
+        auto numberOfOutcomeWaves = (long)outcome.getCascadeWavesInLastMove().size();
+        check(elapsedTime(outcome) == elapsedTime(game) + 1000 + 250*numberOfOutcomeWaves, "an accepted outcome is charged for every wave it cleared");
+    }
+
+    // Plays the first legal swap found from a position picked by the generator, returns false if there is none
+    bool playHugeBoardMove(HugeBoardGame& game, RandomGenerator& randomGenerator) {
+        auto numberOfCells = game.rows()*game.columns();
+        auto start = randomGenerator.nextBelow((uint32_t)numberOfCells);
+        for (size_t i = 0; i < numberOfCells; i++) {
+            auto cell = (start + i) % numberOfCells;
+            auto from = GameBoard::CellPosition((int)(cell / game.columns()), (int)(cell % game.columns()));
+            for (auto to: {GameBoard::CellPosition(from.row, from.column+1), GameBoard::CellPosition(from.row+1, from.column)}) {
+                if (game.isLegalMove(GameBoard::CellSwapMove(from, to))) {
+                    return game.play(GameBoard::CellSwapMove(from, to));
+                }
+            }
+        }
+        return false;
+    }
+
+    bool haveSameCells(const HugeBoardGame& game, const HugeBoardGame& otherGame) {
+        for (size_t row = 0; row < game.rows(); row++) {
+            for (size_t column = 0; column < game.columns(); column++) {
+                auto cell = GameBoard::CellPosition((int)row, (int)column);
+                if (game.cellAt(cell) != otherGame.cellAt(cell)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // The bands a thread works on never change the result, also on a board that ends in partial tiles
+    void testHugeBoardIsTheSameOnAnyNumberOfThreads() {
+        const size_t rows = 203;
+        const size_t columns = 150;
+        auto game = HugeBoardGame::make(rows, columns, 5, 11, 1);
+        std::vector<std::unique_ptr<HugeBoardGame>> threadedGames;
+        for (auto numberOfThreads: {2u, 7u}) {
+            threadedGames.push_back(HugeBoardGame::make(rows, columns, 5, 11, numberOfThreads));
+        }
+        auto isSameGame = true;
+        for (auto& threadedGame: threadedGames) {
+            isSameGame = isSameGame && haveSameCells(*game, *threadedGame);
+        }
+        auto numberOfCascades = 0;
+        RandomGenerator randomGenerator(11);
+        for (auto i = 0; i < 30; i++) {
+            auto moveRandomGenerator = randomGenerator;
+            playHugeBoardMove(*game, randomGenerator);
+            numberOfCascades += game->getNumberOfCascadesInLastMove();
+            for (auto& threadedGame: threadedGames) {
+                auto threadRandomGenerator = moveRandomGenerator;
+                playHugeBoardMove(*threadedGame, threadRandomGenerator);
+                isSameGame = isSameGame && threadedGame->getScore() == game->getScore() && haveSameCells(*game, *threadedGame);
+            }
+        }
+        check(isSameGame, "a huge board has the same cells and score on 1, 2 and 7 threads");
+        check(game->getScore() > 0 && numberOfCascades > 0, "the moves on the huge board score and cascade");
+    }
+
+    // Runs are found across the borders of tiles, horizontally in a band of tile rows and vertically in a band of tile columns
+    void testHugeBoardMatchesAcrossTileBorders() {
+        for (auto numberOfThreads: {1u, 4u}) {
+            const size_t rows = 203;
+            const size_t columns = 150;
+            auto game = HugeBoardGame::make(rows, columns, 5, 3, numberOfThreads);
+
+            // Cell types 1 to 4 without two equal neighbours, so only the runs of type 0 below match
+            for (size_t row = 0; row < rows; row++) {
+                for (size_t column = 0; column < columns; column++) {
+                    HugeBoardGameTests::setCell(*game, row, column, (uint8_t)(1 + (row + 2*column) % 4));
+                }
+            }
+            std::vector<GameBoard::CellPosition> runCells;
+            auto addRun = [&](int row, int column, int rowStep, int columnStep, int length) {
+                for (auto i = 0; i < length; i++) {
+                    runCells.push_back(GameBoard::CellPosition(row + i*rowStep, column + i*columnStep));
+                    HugeBoardGameTests::setCell(*game, (size_t)(row + i*rowStep), (size_t)(column + i*columnStep), 0);
+                }
+            };
+            addRun(10, 62, 0, 1, 4);
+            addRun(62, 20, 1, 0, 3);
+            addRun(127, 126, 0, 1, 3);
+            addRun(128, 128, 1, 0, 2);
+            addRun(202, 147, 0, 1, 3);
+            addRun(190, 149, 1, 0, 12);
+            addRun(40, 100, 0, 1, 2);
+
+            HugeBoardGameTests::markMatches(*game);
+            auto isMatchingRuns = true;
+            for (size_t row = 0; row < rows; row++) {
+                for (size_t column = 0; column < columns; column++) {
+                    auto isRunCell = std::find(runCells.begin(), runCells.end(), GameBoard::CellPosition((int)row, (int)column)) != runCells.end();
+                    auto isShortRunCell = row == 40 && (column == 100 || column == 101);
+                    isMatchingRuns = isMatchingRuns && HugeBoardGameTests::isMatched(*game, row, column) == (isRunCell && !isShortRunCell);
+                }
+            }
+            check(isMatchingRuns, "runs crossing tile borders and ending at the edges of the board are matched, and nothing else");
+        }
+    }
+
+    // A pool that never ran a pass, since a board of one tile is one band, or that is idle after some, stops without waiting
+    void testWorkerPoolStopsWhenIdle() {
+        auto oneTileGame = HugeBoardGame::make(HugeBoardGame::tileSize, HugeBoardGame::tileSize, 5, 1, 4);
+        check(HugeBoardGameTests::hasWorkerPool(*oneTileGame), "a game on four threads has a worker pool");
+        oneTileGame.reset();
+        auto game = HugeBoardGame::make(203, 150, 5, 1, 4);
+        RandomGenerator randomGenerator(1);
+        playHugeBoardMove(*game, randomGenerator);
+        game.reset();
+        check(oneTileGame == nullptr && game == nullptr, "worker pools stop when no pass is running");
+    }
+
+    // The game a move leads to has its cascades cleared and is the game play leaves behind
+    void testGameForMoveClearsCascades() {
+        auto hasNoMatches = true;
+        auto isGameAfterPlay = true;
+        for (uint64_t seed = 1; seed <= 50; seed++) {
+            CandyCrush game(seed, CandyCrush::Clock::virtualClock(1000));
+            for (const auto& move: game.legalMoves()) {
+                auto nextGame = game.gameForMove(move);
+                hasNoMatches = hasNoMatches && Bitboard(nextGame.getGameBoard()).matchedCells() == 0;
+                auto playedGame = game;
+                playedGame.play(move);
+                isGameAfterPlay = isGameAfterPlay && nextGame == playedGame && nextGame.getScore() == playedGame.getScore();
+            }
+        }
+        check(hasNoMatches, "the game for a move has no matches left on its board");
+        check(isGameAfterPlay, "the game for a move is the game after playing it");
+    }
+
+    // The hash kept up to date by the moves is the one of a board with the same cells built from scratch
+    void testHashFollowsEveryMove() {
+        CandyCrush game(7);
+        auto isHashInSync = true;
+        for (auto i = 0; i < 200 && game.hasLegalMoves(); i++) {
+            game.play(game.legalMoves().front());
+            auto& gameBoard = game.getGameBoard();
+            CandyCrush::CandyCrushGameBoard rebuiltBoard([&](size_t row, size_t column) {
+                return gameBoard[row][column];
+            });
+            isHashInSync = isHashInSync && rebuiltBoard.getHash() == gameBoard.getHash();
+        }
+        check(isHashInSync, "the hash of the board after every move is the hash of its cells");
+
+        CandyCrush::CandyCrushGameBoard board(CandyCrush::Green);
+        auto emptyHash = board.getHash();
+        board.setCell(GameBoard::CellPosition(3, 4), CandyCrush::Red);
+        check(board.getHash() != emptyHash, "changing a cell changes the hash");
+        board.swapCells(GameBoard::CellPosition(3, 4), GameBoard::CellPosition(3, 5));
+        board.setCell(GameBoard::CellPosition(3, 5), CandyCrush::Green);
+        check(board.getHash() == emptyHash, "a board changed back has its old hash");
+
+        CandyCrush::CandyCrushGameBoard defaultBoard;
+        check(defaultBoard.getHash() == emptyHash, "a board created without cells has the hash of its cells");
+    }
+
+    // Empty slots must not be mistaken for an entry of key 0
+    void testTranspositionTableKeyZero() {
+        TranspositionTable<int> table(16);
+        auto value = 7;
+        check(!table.lookup(0, value), "key 0 is not found in an empty table");
+        table.store(0, 0);
+        check(table.lookup(0, value) && value == 0, "key 0 is found once it has been stored");
+        table.clear();
+        check(!table.lookup(0, value), "key 0 is not found in a cleared table");
+    }
+}
+
+int main() {
+    testRunsEndAtRowBoundary();
+    testWaveCountsRunsAcrossRowBoundary();
+    testWavesMatchReferenceLoop();
+    testIntersectingMatchesAreRemovedOnce();
+    testSwapCreatesMatchAgreesWithSwapping();
+    testLegalMovesMatchBruteForce();
+    testShapesFallOnOtherBoards();
+    testShapeLegalMovesMatchBruteForce();
+    testReplayOfMovesAtTheTimeLimit();
+    testReplayIgnoresMovesOffTheBoard();
+    testVirtualClockChargesEveryWave();
+    testHashFollowsEveryMove();
+    testTranspositionTableKeyZero();
+    testHugeBoardIsTheSameOnAnyNumberOfThreads();
+    testHugeBoardMatchesAcrossTileBorders();
+    testWorkerPoolStopsWhenIdle();
+    testGameForMoveClearsCascades();
+    if (numberOfFailedChecks == 0) {
+        std::cout << "All checks passed" << std::endl;
+    }
+    return numberOfFailedChecks;
+}
@@ -0,0 +1,25 @@
+#ifndef ThreadCpuClock_hpp
+#define ThreadCpuClock_hpp
+
+#include <chrono>
+#include <ctime>
+
+// Clock of the CPU time used by the calling thread, with the same interface as the std::chrono clocks. It does not move
+// while the thread waits or is not scheduled, so it measures the work of the thread itself: a budget measured with it is
+// not used up by other threads and the time of a frame does not depend on what else runs on the machine. Time points of
+// different threads can not be compared.
+struct ThreadCpuClock {
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<ThreadCpuClock> time_point;
+    static const bool is_steady = true;
+
+    static time_point now() {
+        timespec time;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return time_point(duration((rep)time.tv_sec*1000000000 + time.tv_nsec));
+    }
+};
+
+#endif /* ThreadCpuClock_hpp */
@@ -0,0 +1,161 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace {
+
+    std::atomic<bool> recording {false};
+
+    namespace {
+
+        // A span has a duration, a counter has a value
+        struct Event {
+            const char* name;
+            bool isCounter;
+            long long timestamp;
+            long long durationOrValue;
+        };
+
+        // Written by its own thread only. The events of a new recording replace the old ones the first time the thread
+        // records something in it: the count is cleared before the buffer is marked with the new recording, so whoever sees
+        // the new mark only ever reads events of the new recording.
+        struct ThreadBuffer {
+            int threadId;
+            std::atomic<const char*> threadName {nullptr};
+            std::unique_ptr<Event[]> events;
+            std::atomic<unsigned long> recordingNumber {0};
+            std::atomic<size_t> numberOfEvents {0};
+            std::atomic<long> numberOfDroppedEvents {0};
+        };
+
+        // Buffers are never freed, the events of threads that have exited stay in the trace
+        std::mutex buffersMutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        thread_local ThreadBuffer* threadBuffer = nullptr;
+
+        std::atomic<unsigned long> recordingNumber {0};
+        std::atomic<long long> recordingStartTime {0};
+
+        long long nanoseconds(std::chrono::steady_clock::time_point time) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
+
+        ThreadBuffer& bufferForThisThread() {
+            if (threadBuffer == nullptr) {
+                std::lock_guard<std::mutex> lock(buffersMutex);
+                buffers.emplace_back(new ThreadBuffer());
+                threadBuffer = buffers.back().get();
+                threadBuffer->threadId = (int)buffers.size();
+            }
+            return *threadBuffer;
+        }
+
+        void append(const Event& event) {
+            auto& buffer = bufferForThisThread();
+            auto currentRecordingNumber = recordingNumber.load(std::memory_order_acquire);
+            if (buffer.recordingNumber.load(std::memory_order_relaxed) != currentRecordingNumber) {
+                if (buffer.events == nullptr) {
+                    buffer.events.reset(new Event[eventsPerThread]);
+                }
+                buffer.numberOfEvents.store(0, std::memory_order_relaxed);
+                buffer.numberOfDroppedEvents.store(0, std::memory_order_relaxed);
+                buffer.recordingNumber.store(currentRecordingNumber, std::memory_order_release);
+            }
+            auto numberOfEvents = buffer.numberOfEvents.load(std::memory_order_relaxed);
+            if (numberOfEvents == eventsPerThread) {
+                buffer.numberOfDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            buffer.events[numberOfEvents] = event;
+            buffer.numberOfEvents.store(numberOfEvents+1, std::memory_order_release);
+        }
+    }
+
+    void start() {
+        recordingStartTime = nanoseconds(std::chrono::steady_clock::now());
+        recordingNumber++;
+        recording = true;
+    }
+
+    void stop() {
+        recording = false;
+    }
+
+    void setThreadName(const char* name) {
+        bufferForThisThread().threadName = name;
+    }
+
+    void recordSpan(const char* name, std::chrono::steady_clock::time_point startTime, std::chrono::steady_clock::time_point endTime) {
+        Event event;
+        event.name = name;
+        event.isCounter = false;
+        event.timestamp = nanoseconds(startTime);
+        event.durationOrValue = nanoseconds(endTime) - event.timestamp;
+        append(event);
+    }
+
+    void recordCounter(const char* name, long value) {
+        Event event;
+        event.name = name;
+        event.isCounter = true;
+        event.timestamp = nanoseconds(std::chrono::steady_clock::now());
+        event.durationOrValue = value;
+        append(event);
+    }
+
+    // Times are in microseconds since the recording started, with nanoseconds as decimals. A span that started before the
+    // recording starts with it. Buffers are never freed, so only the list of them is copied under the mutex and threads that
+    // record their first event do not wait for the file to be written.
+    void write(std::ostream& os) {
+        auto currentRecordingNumber = recordingNumber.load(std::memory_order_acquire);
+        auto startTime = recordingStartTime.load();
+        auto microseconds = [&](long long nanoseconds) {
+            return std::to_string(nanoseconds / 1000) + "." + std::to_string(1000 + nanoseconds % 1000).substr(1);
+        };
+
+        std::vector<ThreadBuffer*> buffersToWrite;
+        {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            for (auto& buffer: buffers) {
+                buffersToWrite.push_back(buffer.get());
+            }
+        }
+        long numberOfDroppedEvents = 0;
+        auto isFirstEvent = true;
+        os << "{\"traceEvents\": [";
+        for (auto buffer: buffersToWrite) {
+            auto separator = isFirstEvent ? "\n" : ",\n";
+            isFirstEvent = false;
+            const char* threadName = buffer->threadName;
+            os << separator << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->threadId
+            << ", \"args\": {\"name\": \"" << (threadName != nullptr ? threadName : "Thread") << "\"}}";
+
+            if (buffer->recordingNumber.load(std::memory_order_acquire) != currentRecordingNumber) {
+                continue;
+            }
+            auto numberOfEvents = buffer->numberOfEvents.load(std::memory_order_acquire);
+            for (size_t i = 0; i < numberOfEvents; i++) {
+                auto& event = buffer->events[i];
+                os << ",\n{\"name\": \"" << event.name << "\", \"pid\": 1, \"tid\": " << buffer->threadId
+                << ", \"ts\": " << microseconds(std::max(event.timestamp - startTime, 0LL));
+                if (event.isCounter) {
+                    os << ", \"ph\": \"C\", \"args\": {\"value\": " << event.durationOrValue << "}}";
+                } else {
+                    os << ", \"ph\": \"X\", \"dur\": " << microseconds(event.durationOrValue) << "}";
+                }
+            }
+            numberOfDroppedEvents += buffer->numberOfDroppedEvents;
+        }
+        os << "\n], \"displayTimeUnit\": \"ns\", \"otherData\": {\"droppedEvents\": " << numberOfDroppedEvents << "}}" << std::endl;
+    }
+
+    bool save(const std::string& path) {
+        std::ofstream file(path);
+        write(file);
+        file.close();
+        return !file.fail();
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef Trace_hpp
+#define Trace_hpp
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+
+// Spans and counters recorded on the threads they happen on, which can be written out in the Chrome trace format that
+// chrome://tracing and Perfetto open. They are meant to stay in release builds, so that a slow move or frame can be
+// attributed by turning tracing on while the game runs instead of attaching a profiler.
+//
+// Every thread records into a buffer of its own that only it writes to. An event is written to the next free slot and then
+// published by increasing the number of events in the buffer, so recording never takes a lock and a trace can be written
+// while other threads keep recording. A buffer keeps the first eventsPerThread events after start and counts the ones it
+// has to drop. While tracing is off a span costs one load of a flag, and building with CANDY_CRUSH_TRACING defined to 0
+// removes spans and counters from the code altogether.
+//
+// Names must be string literals or otherwise outlive the trace, only pointers to them are recorded, and they are written
+// to the trace as they are.
+#ifndef CANDY_CRUSH_TRACING
+#define CANDY_CRUSH_TRACING 1
+#endif
+
+namespace Trace {
+
+    static const size_t eventsPerThread = 1 << 16;
+
+    // Set while recording, use isRecording
+    extern std::atomic<bool> recording;
+
+    inline bool isRecording() {
+        return recording.load(std::memory_order_relaxed);
+    }
+
+    // Starts recording, events recorded before are discarded. Must not be called while a trace is being written.
+    void start();
+    void stop();
+
+    // Names the calling thread in the trace
+    void setThreadName(const char* name);
+
+    void recordSpan(const char* name, std::chrono::steady_clock::time_point startTime, std::chrono::steady_clock::time_point endTime);
+    void recordCounter(const char* name, long value);
+
+    // Writes every event recorded since the last start as one JSON object in the Chrome trace format
+    void write(std::ostream& os);
+
+    // Returns false if the file could not be written
+    bool save(const std::string& path);
+
+    // Records the time from its creation to the end of the scope it is created in
+    class Span {
+    private:
+        const char* name;
+        const bool isRecorded;
+        std::chrono::steady_clock::time_point startTime;
+
+    public:
+        Span(const char* name): name(name), isRecorded(isRecording()) {
+            if (isRecorded) {
+                startTime = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~Span() {
+            if (isRecorded) {
+                recordSpan(name, startTime, std::chrono::steady_clock::now());
+            }
+        }
+    };
+}
+
+#if CANDY_CRUSH_TRACING
+#define TRACE_CONCATENATE_LINE(prefix, line) prefix##line
+#define TRACE_SPAN_VARIABLE(line) TRACE_CONCATENATE_LINE(traceSpan, line)
+#define TRACE_SPAN(name) Trace::Span TRACE_SPAN_VARIABLE(__LINE__)(name)
+#define TRACE_COUNTER(name, value) do { if (Trace::isRecording()) { Trace::recordCounter(name, (long)(value)); } } while (false)
+#else
+#define TRACE_SPAN(name) do {} while (false)
+#define TRACE_COUNTER(name, value) do {} while (false)
+#endif
+
+#endif /* Trace_hpp */
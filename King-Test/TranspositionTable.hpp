@@ -0,0 +1,85 @@
+#ifndef TranspositionTable_hpp
+#define TranspositionTable_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// Fixed size hash table from 64 bit position hashes to small values, meant to be shared by searches running on many threads.
+//
+// It is lock free: every slot holds the value and the key XORed with the value in two atomic words. A reader that sees the
+// two words from different writes gets a key that does not match and treats the slot as empty, so torn entries are never
+// returned. Newer entries always replace older ones in the same slot. An empty slot looks like key 0 with a value of all zero
+// bits, so key 0 is stored under another key.
+template<typename Value>
+class TranspositionTable {
+    static_assert(sizeof(Value) <= sizeof(uint64_t), "Values must fit in 64 bits");
+    static_assert(std::is_trivially_copyable<Value>::value, "Values are copied bitwise");
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> keyXorData {0};
+        std::atomic<uint64_t> data {0};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    uint64_t slotMask;
+
+    // The hash of a position is as likely to be this key as to be 0, so using it for 0 adds no more than one more collision
+    static uint64_t storedKey(const uint64_t key) {
+        return key != 0 ? key : 0x9e3779b97f4a7c15;
+    }
+
+    static uint64_t dataForValue(const Value& value) {
+        uint64_t data = 0;
+        std::memcpy(&data, &value, sizeof(Value));
+        return data;
+    }
+
+public:
+    // The number of slots is rounded up to a power of two
+    TranspositionTable(size_t numberOfSlots) {
+        size_t size = 1;
+        while (size < numberOfSlots) {
+            size *= 2;
+        }
+        slots.reset(new Slot[size]);
+        slotMask = size - 1;
+    }
+
+    size_t size() const {
+        return (size_t)slotMask + 1;
+    }
+
+    void store(const uint64_t positionKey, const Value& value) {
+        auto key = storedKey(positionKey);
+        auto& slot = slots[key & slotMask];
+        auto data = dataForValue(value);
+        slot.keyXorData.store(key ^ data, std::memory_order_relaxed);
+        slot.data.store(data, std::memory_order_relaxed);
+    }
+
+    // Returns whether the key was found, in which case its value is written to value
+    bool lookup(const uint64_t positionKey, Value& value) const {
+        auto key = storedKey(positionKey);
+        const auto& slot = slots[key & slotMask];
+        auto keyXorData = slot.keyXorData.load(std::memory_order_relaxed);
+        auto data = slot.data.load(std::memory_order_relaxed);
+        if ((keyXorData ^ data) != key) {
+            return false;
+        }
+        std::memcpy(&value, &data, sizeof(Value));
+        return true;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < size(); i++) {
+            slots[i].keyXorData.store(0, std::memory_order_relaxed);
+            slots[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif /* TranspositionTable_hpp */
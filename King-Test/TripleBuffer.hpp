@@ -0,0 +1,58 @@
+#ifndef TripleBuffer_hpp
+#define TripleBuffer_hpp
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one writer thread to one reader thread without locks and without either of them waiting.
+//
+// The writer fills the back buffer and publishes it by swapping it with the middle buffer. The reader takes the middle
+// buffer by swapping it with its front buffer, but only when something new was published since it last did. The writer
+// never touches the front buffer and the reader never touches the back buffer, so the reader can keep using the value it
+// took for as long as it wants. Values that the writer publishes faster than the reader takes them are skipped.
+template<typename T>
+class TripleBuffer {
+private:
+    T buffers[3];
+
+    // Index of the middle buffer, together with newValueFlag when it holds a value the reader has not taken yet
+    std::atomic<uint8_t> middle {1};
+    static const uint8_t newValueFlag = 4;
+    static const uint8_t indexMask = 3;
+
+    // Owned by the writer and the reader respectively
+    uint8_t back = 0;
+    uint8_t front = 2;
+
+public:
+    // Writer only
+    T& backBuffer() {
+        return buffers[back];
+    }
+
+    // Writer only, the back buffer is then the buffer that was published before, or taken by the reader before
+    void publish() {
+        back = middle.exchange(back | newValueFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Reader only, takes the latest published value and returns whether there was a new one
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & newValueFlag) == 0) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    // Reader only, whether update would take a new value
+    bool hasNewValue() const {
+        return (middle.load(std::memory_order_relaxed) & newValueFlag) != 0;
+    }
+
+    // Reader only, the value stays the same until the next update
+    const T& frontBuffer() const {
+        return buffers[front];
+    }
+};
+
+#endif /* TripleBuffer_hpp */
@@ -1,16 +1,40 @@
 
+#include <algorithm>
 #include <iostream>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include "CandyCrush.hpp"
+#include "GameThread.hpp"
+#include "HintEngine.hpp"
+#include "ThreadCpuClock.hpp"
+#include "Trace.hpp"
 #include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <thread>
 #include <SDL2/SDL.h>
 #include <SDL2_image/SDL_image.h>
 #include <SDL2_ttf/SDL_ttf.h>
 
 struct GameEngine {
-    CandyCrush game;
+    
+    // The game is played on its own thread and the engine only reads the snapshots of it that the thread publishes. Every
+    // game is recorded there so that bugs reported by players can be reproduced from the replay saved at game over.
+    std::unique_ptr<GameThread> gameThread;
+    
+    // Set while a new game has been sent to the game thread and its intro animation has not been queued yet
+    bool isStartingNewGame = false;
+    
+    // Looks for a move to suggest on a background thread while the board is at rest. The best move found so far is shown
+    // when the player has not clicked for hintDelaySeconds.
+    std::unique_ptr<HintEngine> hintEngine;
+    const double hintDelaySeconds = 5;
+    bool isSearchingForHint = false;
+    std::chrono::steady_clock::time_point hintSearchStartTime;
+    std::chrono::steady_clock::time_point lastClickTime;
     
     bool isFirstGame = true;
     
@@ -23,20 +47,67 @@ struct GameEngine {
     const int windowWidth = 755;
     const int windowHeight = 600;
     
-    const int cellHeight = gameBoardRect.h / (int)game.getGameBoard().rows;
-    const int cellWidth = gameBoardRect.w / (int)game.getGameBoard().columns;
+    const int cellHeight = gameBoardRect.h / (int)CandyCrush::CandyCrushGameBoard::rows;
+    const int cellWidth = gameBoardRect.w / (int)CandyCrush::CandyCrushGameBoard::columns;
     
     SDL_Window* window = nullptr;
     SDL_Renderer * renderer = nullptr;
     
-    std::unordered_map<CandyCrush::Cell, SDL_Texture*> cellTextures;
+    // All cell images are packed side by side into one texture, so the whole board can be drawn with a single draw call.
+    // The part of the atlas that holds each cell type is looked up by the cell type.
+    SDL_Texture* cellAtlas = nullptr;
+    int cellAtlasWidth = 0;
+    int cellAtlasHeight = 0;
+    SDL_Rect cellSprites[CandyCrush::numberOfCellTypes];
+    
+    // Quads of the cells drawn in the current frame, the buffers are kept between frames so that they are only allocated once
+    std::vector<SDL_Vertex> spriteVertices;
+    std::vector<int> spriteIndices;
     SDL_Texture* backgroundTexture = nullptr;
     
     TTF_Font* scoreLabelFont = nullptr;
     TTF_Font* timeLeftLabelFont = nullptr;
     
+    // Text that rarely changes is rasterised once and its texture is kept until the text changes
+    struct CachedLabel {
+        std::string text;
+        SDL_Texture* texture = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+    CachedLabel scoreLabel;
+    CachedLabel messageLabel;
+    
+    // The digits of a font rendered once side by side, so that counters are drawn without rasterising any text
+    struct DigitStrip {
+        SDL_Texture* texture = nullptr;
+        SDL_Rect digits[10];
+    };
+    DigitStrip scoreDigits;
+    DigitStrip timeLeftDigits;
+    
+    // Headless engines render in software into a window that is never shown, for benchmarks on machines without a display
+    bool isHeadless = false;
+    
+    // Draw calls and texture uploads since the counters were reset, the benchmark reports them per frame
+    struct RenderCounters {
+        long drawCalls = 0;
+        long textureUploads = 0;
+    };
+    RenderCounters renderCounters;
+    
+    // How long the last frames took to render and present, shown as a histogram by the frame time overlay
+    static const int numberOfRecentFrames = 240;
+    double recentFrameMilliseconds[numberOfRecentFrames] = {};
+    long numberOfFrames = 0;
+    bool isShowingFrameTimes = false;
     
-    GameEngine() {
+    // Pressing T records a trace of where the time goes in moves and frames, it is saved next to the replay of the last game
+    const char* tracePath = "last-trace.json";
+    
+    
+    GameEngine(bool isHeadless = false): isHeadless(isHeadless) {
+        Trace::setThreadName("Main");
         if( SDL_Init( SDL_INIT_VIDEO ) < 0 ) {
             printf( "SDL could not initialize! SDL_Error: %s\n", SDL_GetError() );
             throw;
@@ -47,7 +118,7 @@ struct GameEngine {
             throw;
         }
         
-        window = SDL_CreateWindow("SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
+        window = SDL_CreateWindow("SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, windowWidth, windowHeight, isHeadless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN);
         if( window == nullptr) {
             printf( "Window could not be created! SDL_Error: %s\n", SDL_GetError() );
             throw;
@@ -62,326 +133,909 @@ struct GameEngine {
             throw;
         }
         
-        renderer = SDL_CreateRenderer(window, -1, 0);
+        // The game thread wakes up the event loop whenever it has published something
+        auto gameUpdateEvent = SDL_RegisterEvents(1);
+        std::function<void()> onGameUpdate = [gameUpdateEvent] {
+            SDL_Event event = {};
+            event.type = gameUpdateEvent;
+            SDL_PushEvent(&event);
+        };
+        gameThread.reset(new GameThread(isHeadless ? nullptr : onGameUpdate, isHeadless ? "" : "last-game.replay"));
+        
+        // Hints depend on how long the player has been idle, which would make the frames of the benchmark differ between runs
+        if (!isHeadless) {
+            hintEngine.reset(new HintEngine());
+        }
+        
+        // Presenting waits for the display so that animations advance once per displayed frame
+        auto rendererFlags = isHeadless ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC;
+        renderer = SDL_CreateRenderer(window, -1, rendererFlags | SDL_RENDERER_TARGETTEXTURE);
+        if (renderer == nullptr) {
+            printf( "Renderer could not be created! SDL_Error: %s\n", SDL_GetError() );
+            throw;
+        }
+        frameTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, windowWidth, windowHeight);
+        if (frameTexture == nullptr) {
+            printf( "Frame texture could not be created! SDL_Error: %s\n", SDL_GetError() );
+            throw;
+        }
+        SDL_SetRenderTarget(renderer, frameTexture);
         
         // Load assets
-        cellTextures = {
-            {CandyCrush::Blue, SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/Blue.png"))},
-            {CandyCrush::Green, SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/Green.png"))},
-            {CandyCrush::Red, SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/Red.png"))},
-            {CandyCrush::Purple, SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/Purple.png"))},
-            {CandyCrush::Yellow, SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/Yellow.png"))},
-        };
+        loadCellAtlas();
+        scoreDigits = createDigitStrip(scoreLabelFont);
+        timeLeftDigits = createDigitStrip(timeLeftLabelFont);
         
         backgroundTexture = SDL_CreateTextureFromSurface(renderer, IMG_Load("assets/BackGround.jpg"));
     }
     
     
     ~GameEngine() {
-        for (auto cellImage: cellTextures) {
-            SDL_DestroyTexture(cellImage.second);
-        }
+        SDL_DestroyTexture(cellAtlas);
+        SDL_DestroyTexture(scoreLabel.texture);
+        SDL_DestroyTexture(messageLabel.texture);
+        SDL_DestroyTexture(scoreDigits.texture);
+        SDL_DestroyTexture(timeLeftDigits.texture);
         SDL_DestroyTexture(backgroundTexture);
+        SDL_DestroyTexture(frameTexture);
+    }
+    
+    
+    // Packs the cell images into the atlas in the order of the cell types, with a transparent pixel between them so that
+    // filtering never blends one cell image into the next
+    void loadCellAtlas() {
+        const char* paths[CandyCrush::numberOfCellTypes] = {"assets/Green.png", "assets/Blue.png", "assets/Purple.png", "assets/Red.png", "assets/Yellow.png"};
+        SDL_Surface* surfaces[CandyCrush::numberOfCellTypes];
+        for (size_t cell = 0; cell < CandyCrush::numberOfCellTypes; cell++) {
+            surfaces[cell] = IMG_Load(paths[cell]);
+            if (!surfaces[cell]) {
+                printf( "Image could not be loaded! SDL_Error: %s\n", SDL_GetError() );
+                throw;
+            }
+            cellSprites[cell] = SDL_Rect{cellAtlasWidth, 0, surfaces[cell]->w, surfaces[cell]->h};
+            cellAtlasWidth += surfaces[cell]->w + 1;
+            cellAtlasHeight = std::max(cellAtlasHeight, surfaces[cell]->h);
+        }
+        
+        auto atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, cellAtlasWidth, cellAtlasHeight, 32, SDL_PIXELFORMAT_RGBA32);
+        for (size_t cell = 0; cell < CandyCrush::numberOfCellTypes; cell++) {
+            
+            // Copies the alpha channel as it is instead of blending it onto the empty atlas
+            SDL_SetSurfaceBlendMode(surfaces[cell], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(surfaces[cell], nullptr, atlasSurface, &cellSprites[cell]);
+            SDL_FreeSurface(surfaces[cell]);
+        }
+        cellAtlas = SDL_CreateTextureFromSurface(renderer, atlasSurface);
+        SDL_SetTextureBlendMode(cellAtlas, SDL_BLENDMODE_BLEND);
+        SDL_FreeSurface(atlasSurface);
+    }
+    
+    // Adds a cell to the quads drawn by renderSprites. The top cutoff pixels of the cell image are left out.
+    // Cells that have shrunk away or are still completely above the board have no area and are skipped.
+    void addSprite(CandyCrush::Cell cell, const SDL_Rect& destination, int cutoff = 0) {
+        if (destination.w <= 0 || destination.h <= 0) {
+            return;
+        }
+        const auto& sprite = cellSprites[cell];
+        auto left = (float)sprite.x / cellAtlasWidth;
+        auto right = (float)(sprite.x + sprite.w) / cellAtlasWidth;
+        auto top = (float)(sprite.y + cutoff) / cellAtlasHeight;
+        auto bottom = (float)(sprite.y + sprite.h) / cellAtlasHeight;
+        auto x = (float)destination.x;
+        auto y = (float)destination.y;
+        auto w = (float)destination.w;
+        auto h = (float)destination.h;
+        SDL_Color white = {255, 255, 255, 255};
+        
+        auto firstVertex = (int)spriteVertices.size();
+        spriteVertices.push_back({{x, y}, white, {left, top}});
+        spriteVertices.push_back({{x + w, y}, white, {right, top}});
+        spriteVertices.push_back({{x + w, y + h}, white, {right, bottom}});
+        spriteVertices.push_back({{x, y + h}, white, {left, bottom}});
+        for (auto index: {0, 1, 2, 0, 2, 3}) {
+            spriteIndices.push_back(firstVertex + index);
+        }
     }
     
+    // Draws all cells added since the last call with one draw call
+    void renderSprites() {
+        if (!spriteVertices.empty()) {
+            renderCounters.drawCalls++;
+            SDL_RenderGeometry(renderer, cellAtlas, spriteVertices.data(), (int)spriteVertices.size(), spriteIndices.data(), (int)spriteIndices.size());
+        }
+        spriteVertices.clear();
+        spriteIndices.clear();
+    }
     
-    SDL_Rect rectForCellPosition(const GameBoard::CellPosition& cellPosition, SDL_Texture * image) {
-        int w, h;
-        SDL_QueryTexture(image, NULL, NULL, &w, &h);
+    SDL_Rect rectForCellPosition(const GameBoard::CellPosition& cellPosition, CandyCrush::Cell cell) {
+        auto w = cellSprites[cell].w;
+        auto h = cellSprites[cell].h;
         return SDL_Rect{cellWidth*cellPosition.column+cellWidth/2-w/2 + gameBoardRect.x, cellHeight*cellPosition.row+cellHeight/2-h/2+gameBoardRect.y, w, h};
     }
     
     
-    void renderText(std::string text, int x, int y, TTF_Font *font) {
+    SDL_Surface* renderTextSurface(const std::string& text, TTF_Font *font) {
         SDL_Color whiteColor = {255, 255, 255};
-        SDL_Surface* label = TTF_RenderText_Solid(font, text.c_str(), whiteColor);
-        auto labelRect = SDL_Rect{x, y, label->w,label->h};
-        SDL_Texture* labelTexture = SDL_CreateTextureFromSurface( renderer, label );
-        SDL_FreeSurface(label);
-        SDL_RenderCopy(renderer, labelTexture, NULL, &labelRect);
-        SDL_DestroyTexture(labelTexture);
+        return TTF_RenderText_Solid(font, text.c_str(), whiteColor);
+    }
+    
+    // Only rasterises the text when it is not the text the label already shows
+    void renderText(CachedLabel& label, const std::string& text, int x, int y, TTF_Font *font) {
+        if (label.texture == nullptr || label.text != text) {
+            SDL_DestroyTexture(label.texture);
+            auto surface = renderTextSurface(text, font);
+            label.texture = SDL_CreateTextureFromSurface(renderer, surface);
+            renderCounters.textureUploads++;
+            label.width = surface->w;
+            label.height = surface->h;
+            label.text = text;
+            SDL_FreeSurface(surface);
+        }
+        auto labelRect = SDL_Rect{x, y, label.width, label.height};
+        renderCounters.drawCalls++;
+        SDL_RenderCopy(renderer, label.texture, NULL, &labelRect);
+    }
+    
+    DigitStrip createDigitStrip(TTF_Font *font) {
+        DigitStrip strip;
+        SDL_Surface* surfaces[10];
+        auto width = 0;
+        auto height = 0;
+        for (auto digit = 0; digit < 10; digit++) {
+            surfaces[digit] = renderTextSurface(std::to_string(digit), font);
+            strip.digits[digit] = SDL_Rect{width, 0, surfaces[digit]->w, surfaces[digit]->h};
+            width += surfaces[digit]->w;
+            height = std::max(height, surfaces[digit]->h);
+        }
+        auto stripSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+        for (auto digit = 0; digit < 10; digit++) {
+            SDL_BlitSurface(surfaces[digit], nullptr, stripSurface, &strip.digits[digit]);
+            SDL_FreeSurface(surfaces[digit]);
+        }
+        strip.texture = SDL_CreateTextureFromSurface(renderer, stripSurface);
+        SDL_FreeSurface(stripSurface);
+        return strip;
+    }
+    
+    // Draws a number that is not negative with its left edge at x
+    void renderNumber(const DigitStrip& strip, int number, int x, int y) {
+        char digits[16];
+        auto numberOfDigits = 0;
+        do {
+            digits[numberOfDigits++] = (char)(number % 10);
+            number /= 10;
+        } while (number > 0);
+        for (auto i = numberOfDigits - 1; i >= 0; i--) {
+            const auto& source = strip.digits[(int)digits[i]];
+            auto destination = SDL_Rect{x, y, source.w, source.h};
+            renderCounters.drawCalls++;
+            SDL_RenderCopy(renderer, strip.texture, &source, &destination);
+            x += source.w;
+        }
     }
     
     
-    void renderScore() {
-        renderText("Score: " + std::to_string(game.getScore()), 20, 20, scoreLabelFont);
+    void renderScore(int score) {
+        renderText(scoreLabel, "Score: ", 20, 20, scoreLabelFont);
+        renderNumber(scoreDigits, score, 20 + scoreLabel.width, 20);
     }
     
     
     void renderBackground() {
+        renderCounters.drawCalls++;
         SDL_RenderCopy(renderer, backgroundTexture, NULL, NULL);
     }
     
     
-    void renderGameOver() {
-        
-        // All cells will be hidden one by one in a spiral fashion
-        bool isCellVisible[game.getGameBoard().rows][game.getGameBoard().columns];
-        for (auto row = 0; row < game.getGameBoard().rows; row++) {
-            for (auto column = 0; column < game.getGameBoard().columns; column++) {
-                isCellVisible[row][column] = true;
-            }
-        }
-        
-        // Animates hiding of the selected cell and hides all previously hidden cells
-        auto renderSpiral = [&](int selectedRow, int selectedColumn) {
-            for (int distance = 0; distance < cellWidth; distance += 4) {
-                SDL_RenderClear(renderer);
-                SDL_RenderCopy(renderer, backgroundTexture, NULL, NULL);
-                renderScore();
-                for (auto row = 0; row < game.getGameBoard().rows; row++) {
-                    for (auto column = 0; column < game.getGameBoard().columns; column++) {
-                        auto cell = game.getGameBoard()[row][column];
-                        auto image = cellTextures[cell];
-                        auto fromDestination = rectForCellPosition(GameBoard::CellPosition(row, column), image);
-                        if (row == selectedRow && column == selectedColumn) {
-                            fromDestination.x += distance/2;
-                            fromDestination.y += distance/2;
-                            fromDestination.w -= distance;
-                            fromDestination.h -= distance;
-                            isCellVisible[row][column] = false;
-                            SDL_RenderCopy(renderer, image, nullptr, &fromDestination);
-                        } else if (isCellVisible[row][column]) {
-                            SDL_RenderCopy(renderer, image, nullptr, &fromDestination);
-                        }
-                        
-                    }
-                }
-                SDL_RenderPresent(renderer);
-                //                    SDL_Delay(50);
-                
-            }
-        };
-        
-        // Spiral iteration over game board :)
+    // Cells in the order they are hidden at game over, a spiral from the top left corner inwards
+    std::vector<GameBoard::CellPosition> spiralOrder() const {
+        std::vector<GameBoard::CellPosition> cells;
         int depth = 0;
-        while (depth <= game.getGameBoard().columns/2) {
+        while (depth <= game().getGameBoard().columns/2) {
             int topRow = depth;
-            for (auto selectedColumn = depth; selectedColumn < game.getGameBoard().columns-depth; selectedColumn++) {
-                renderSpiral(topRow, selectedColumn);
+            for (auto selectedColumn = depth; selectedColumn < game().getGameBoard().columns-depth; selectedColumn++) {
+                cells.push_back({topRow, selectedColumn});
             }
             
-            int rightColumn = (int)game.getGameBoard().columns-1-depth;
-            for (int selectedRow = depth+1; selectedRow < game.getGameBoard().rows-1-depth; selectedRow++) {
-                renderSpiral(selectedRow, rightColumn);
+            int rightColumn = (int)game().getGameBoard().columns-1-depth;
+            for (int selectedRow = depth+1; selectedRow < game().getGameBoard().rows-1-depth; selectedRow++) {
+                cells.push_back({selectedRow, rightColumn});
             }
             
             
-            int bottomRow = (int)game.getGameBoard().rows - depth - 1;
+            int bottomRow = (int)game().getGameBoard().rows - depth - 1;
             if (topRow != bottomRow) {
-                for (int selectedColumn = (int)game.getGameBoard().columns-1-depth; selectedColumn >= depth; selectedColumn--) {
-                    renderSpiral(bottomRow, selectedColumn);
+                for (int selectedColumn = (int)game().getGameBoard().columns-1-depth; selectedColumn >= depth; selectedColumn--) {
+                    cells.push_back({bottomRow, selectedColumn});
                 }
             }
             
             int leftColumn = depth;
             if (leftColumn != rightColumn) {
-                for (int selectedRow = (int)game.getGameBoard().rows-2-depth; selectedRow >= depth+1; selectedRow--) {
-                    renderSpiral(selectedRow, leftColumn);
+                for (int selectedRow = (int)game().getGameBoard().rows-2-depth; selectedRow >= depth+1; selectedRow--) {
+                    cells.push_back({selectedRow, leftColumn});
                 }
             }
             depth++;
         }
-        
-        SDL_Delay(500);
-        
+        return cells;
+    }
+    
+    // Time it takes to hide one cell at game over, and how long the empty board is shown before the game over text
+    const double cellHidingSeconds = 0.03;
+    const double emptyBoardSeconds = 0.5;
+    
+    // New games can be started this long after the game over text is shown
+    const double gameOverTextSeconds = 2;
+    
+    double secondsUntilGameOverText() const {
+        return cellHidingSeconds*game().getGameBoard().rows*game().getGameBoard().columns + emptyBoardSeconds;
+    }
+    
+    double gameOverSeconds() const {
+        return secondsUntilGameOverText() + gameOverTextSeconds;
+    }
+    
+    // Renders the game over animation as it is the given number of seconds after the game ended.
+    // All cells are hidden one by one in a spiral fashion and then the game over text is shown.
+    void renderGameOver(double seconds) {
+        SDL_RenderClear(renderer);
         renderBackground();
-        renderText("GAME OVER", 390, 250, scoreLabelFont);
-        renderScore();
+        renderScore(game().getScore());
         
+        auto cells = spiralOrder();
+        if (seconds >= secondsUntilGameOverText()) {
+            renderText(messageLabel, "GAME OVER", 390, 250, scoreLabelFont);
+            return;
+        }
+        for (size_t i = 0; i < cells.size(); i++) {
+            auto hidingSeconds = seconds - i*cellHidingSeconds;
+            if (hidingSeconds >= cellHidingSeconds) {
+                continue;
+            }
+            
+            // Cells shrink towards their center while they are hidden
+            auto distance = hidingSeconds > 0 ? (int)(hidingSeconds / cellHidingSeconds * cellWidth) : 0;
+            auto cell = game().getGameBoard()[cells[i]];
+            auto fromDestination = rectForCellPosition(cells[i], cell);
+            fromDestination.x += distance/2;
+            fromDestination.y += distance/2;
+            fromDestination.w -= distance;
+            fromDestination.h -= distance;
+            addSprite(cell, fromDestination);
+        }
+        renderSprites();
     }
     
+    // Pixels per second that cells move with when they are swapped or fall, and that removed cells shrink with
+    const double cellPixelsPerSecond = 250;
+    
+    // A step of a move waiting to be animated, with the board and score as they were when the step was made.
+    // The game has already made all steps of a move when the first one is animated.
+    struct BoardAnimation {
+        CandyCrush::CandyCrushGameBoard gameBoard;
+        CandyCrushGameBoardChange gameBoardChange;
+        int score;
+        double pixelsPerSecond;
+    };
+    std::deque<BoardAnimation> boardAnimations;
     
-    void renderGameBoard(CandyCrushGameBoardChange& gameBoardChange, int distanceStep = 1) {
-        //        auto startTime = std::chrono::high_resolution_clock::now();
-        auto finishedRendering = false;
+    // The first step in the queue is timed from the frame it was first rendered in
+    bool hasAnimationStarted = false;
+    std::chrono::steady_clock::time_point animationStartTime;
+    
+    // Renders the animation as it is the given number of seconds after it started, returns whether it has finished
+    bool renderGameBoard(const BoardAnimation& animation, double seconds) {
+        auto finishedRendering = true;
+        const auto& gameBoard = animation.gameBoard;
+        const auto& gameBoardChange = animation.gameBoardChange;
+        
+        // Where every cell is animated from and what it shows, cells that are not in the change stay where they are
+        std::pair<GameBoard::CellPosition, CandyCrush::Cell> cellOrigins[CandyCrush::CandyCrushGameBoard::rows][CandyCrush::CandyCrushGameBoard::columns];
+        for (auto row = 0; row < gameBoard.rows; row++) {
+            for (auto column = 0; column < gameBoard.columns; column++) {
+                cellOrigins[row][column] = {GameBoard::CellPosition(row, column), gameBoard[row][column]};
+            }
+        }
+        for (const auto& movedCell: gameBoardChange.movedCells) {
+            cellOrigins[movedCell.to().row][movedCell.to().column] = {movedCell.from(), movedCell.cell()};
+        }
         
         // Number of pixels moved
-        auto distance = 0;
+        auto distance = (int)(seconds * animation.pixelsPerSecond);
         
+        SDL_RenderClear(renderer);
         
-        // Render until all cells have been moved to the place they belong
-        while (!finishedRendering){
-            finishedRendering = true;
-            SDL_RenderClear(renderer);
-            
-            renderBackground();
-            renderScore();
-            renderText(std::to_string(game.numberOfSecondsLeft()), 80, 415, timeLeftLabelFont);
+        renderBackground();
+        renderScore(animation.score);
+        renderNumber(timeLeftDigits, game().numberOfSecondsLeft(), 80, 415);
+        
+        // Render rectangle around selected cell
+        auto selectedCell = cellPositionFromCoordinates(lastMouseDownX, lastMouseDownY);
+        if (gameBoard.isCellValid(selectedCell)) {
+            auto selectedCellRect = rectForCellPosition(selectedCell, CandyCrush::Blue);
+            SDL_SetRenderDrawColor(renderer, 255, 80, 80, 1);
+            renderCounters.drawCalls++;
+            SDL_RenderDrawRect(renderer, &selectedCellRect);
+        }
+        
+        for (const auto& removedCell: gameBoardChange.removedCells) {
+            auto fromDestination = rectForCellPosition(removedCell.position(), removedCell.cell());
             
-            // Render rectangle around selected cell
-            auto selectedCell = cellPositionFromCoordinates(lastMouseDownX, lastMouseDownY);
-            if (game.getGameBoard().isCellValid(selectedCell)) {
-                auto selectedCellRect = rectForCellPosition(selectedCell, cellTextures[CandyCrush::Blue]);
-                SDL_SetRenderDrawColor(renderer, 255, 80, 80, 1);
-                SDL_RenderDrawRect(renderer, &selectedCellRect);
-            }
+            fromDestination.x += distance/2;
+            fromDestination.y += distance/2;
+            fromDestination.w -= distance;
+            fromDestination.h -= distance;
             
-            for (auto removedCell: gameBoardChange.removedCells) {
-                auto image = cellTextures[removedCell.second];
-                auto fromDestination = rectForCellPosition(removedCell.first, image);
+            addSprite(removedCell.cell(), fromDestination);
+        }
+        
+        // Render game board
+        for (auto row = 0; row < gameBoard.rows; row++) {
+            for (auto column = 0; column < gameBoard.columns; column++) {
+                auto to = GameBoard::CellPosition(row, column);
+                auto from = cellOrigins[row][column].first;
+                auto cell = cellOrigins[row][column].second;
+                
+                auto fromDestination = rectForCellPosition(from, cell);
+                auto toDestination = rectForCellPosition(to, cell);
+                
+                
+                if (toDestination.x > fromDestination.x) {
+                    fromDestination.x = std::min(fromDestination.x + distance, toDestination.x);
+                } else {
+                    fromDestination.x = std::max(fromDestination.x - distance, toDestination.x);
+                }
+                
+                if (toDestination.y > fromDestination.y) {
+                    fromDestination.y = std::min(fromDestination.y + distance, toDestination.y);
+                } else {
+                    fromDestination.y = std::max(fromDestination.y - distance, toDestination.y);
+                }
                 
-                fromDestination.x += distance/2;
-                fromDestination.y += distance/2;
-                fromDestination.w -= distance;
-                fromDestination.h -= distance;
+                if (fromDestination.x != toDestination.x || fromDestination.y != toDestination.y) {
+                    finishedRendering = false;
+                }
+                
+                // Parts of the new cells animating from above should be visible before they have reched the top row
+                auto extendedGameBoardY = gameBoardRect.y-18;
                 
-                SDL_RenderCopy(renderer, image, nullptr, &fromDestination);
+                // Handle animation from over the board
+                auto cutoff = std::max(extendedGameBoardY-fromDestination.y, 0);
+                
+                if (fromDestination.y < extendedGameBoardY) {
+                    fromDestination.y = extendedGameBoardY;
+                    fromDestination.h -= cutoff;
+                }
+                addSprite(cell, fromDestination, cutoff);
             }
-            
-            // Render game board
-            for (auto row = 0; row < game.getGameBoard().rows; row++) {
-                for (auto column = 0; column < game.getGameBoard().columns; column++) {
-                    auto to = GameBoard::CellPosition(row, column);
-                    auto from = gameBoardChange.gameBoardChange[to].first;
-                    auto cell = gameBoardChange.gameBoardChange[to].second;
-                    
-                    const auto& image = cellTextures[cell];
-                    
-                    
-                    auto fromDestination = rectForCellPosition(from, image);
-                    auto toDestination = rectForCellPosition(to, image);
-                    
-                    
-                    if (toDestination.x > fromDestination.x) {
-                        fromDestination.x = std::min(fromDestination.x + distance, toDestination.x);
-                    } else {
-                        fromDestination.x = std::max(fromDestination.x - distance, toDestination.x);
-                    }
-                    
-                    if (toDestination.y > fromDestination.y) {
-                        fromDestination.y = std::min(fromDestination.y + distance, toDestination.y);
-                    } else {
-                        fromDestination.y = std::max(fromDestination.y - distance, toDestination.y);
+        }
+        renderSprites();
+        return finishedRendering;
+    }
+    
+    GameBoard::CellPosition cellPositionFromCoordinates(int x, int y) const {
+        return GameBoard::CellPosition((y-gameBoardRect.y)/cellHeight, (x-gameBoardRect.x)/cellWidth);
+    }
+    
+    // Set when the game over animation has started, the animation is timed from it
+    bool isShowingGameOver = false;
+    std::chrono::steady_clock::time_point gameOverStartTime;
+    
+    bool quit = false;
+    bool isMouseDown = false;
+    
+    // Frames are drawn into this texture and copied to the window when they are presented. What was drawn stays in it, so a
+    // frame where little has changed only repaints the parts that changed.
+    SDL_Texture* frameTexture = nullptr;
+    
+    enum class Screen {Nothing, Start, Board, GameOver};
+    
+    // What the frame texture shows. Frames of the board at rest are compared with it to find the parts that need repainting.
+    struct ShownScreen {
+        Screen screen = Screen::Nothing;
+        CandyCrush::CandyCrushGameBoard gameBoard;
+        GameBoard::CellPosition selectedCell;
+        int score = 0;
+        int secondsLeft = 0;
+        bool isShowingHint = false;
+        GameBoard::CellSwapMove hintedMove = GameBoard::CellSwapMove(GameBoard::CellPosition(0, 0), GameBoard::CellPosition(0, 0));
+    };
+    ShownScreen shownScreen;
+    std::vector<SDL_Rect> dirtyRects;
+    
+    void presentFrame() {
+        TRACE_SPAN("presentFrame");
+        SDL_SetRenderTarget(renderer, nullptr);
+        renderCounters.drawCalls++;
+        SDL_RenderCopy(renderer, frameTexture, NULL, NULL);
+        
+        // The overlay is drawn over the window only, so the frame texture never has to repaint what it covered
+        if (isShowingFrameTimes) {
+            renderFrameTimes();
+        }
+        SDL_RenderPresent(renderer);
+        SDL_SetRenderTarget(renderer, frameTexture);
+    }
+    
+    void recordFrameTime(double milliseconds) {
+        recentFrameMilliseconds[numberOfFrames % numberOfRecentFrames] = milliseconds;
+        numberOfFrames++;
+    }
+    
+    // Histogram of the recent frame times in buckets of 1 ms over the top right corner of the window. Buckets of frames
+    // that take longer than a frame at 60 Hz are red, and the last bucket also counts all slower frames.
+    void renderFrameTimes() {
+        const int numberOfBuckets = 34;
+        const int barWidth = 4;
+        const int histogramHeight = 60;
+        int buckets[numberOfBuckets] = {};
+        auto count = (int)std::min<long>(numberOfFrames, numberOfRecentFrames);
+        for (auto i = 0; i < count; i++) {
+            buckets[std::min((int)recentFrameMilliseconds[i], numberOfBuckets - 1)]++;
+        }
+        
+        auto histogramRect = SDL_Rect{windowWidth - numberOfBuckets*barWidth - 10, 10, numberOfBuckets*barWidth, histogramHeight};
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderFillRect(renderer, &histogramRect);
+        SDL_Rect bars[numberOfBuckets];
+        for (auto bucket = 0; bucket < numberOfBuckets; bucket++) {
+            auto barHeight = count > 0 ? buckets[bucket]*histogramHeight/count : 0;
+            bars[bucket] = SDL_Rect{histogramRect.x + bucket*barWidth, histogramRect.y + histogramHeight - barHeight, barWidth - 1, barHeight};
+        }
+        const int firstSlowBucket = 17;
+        SDL_SetRenderDrawColor(renderer, 80, 255, 80, 255);
+        SDL_RenderFillRects(renderer, bars, firstSlowBucket);
+        SDL_SetRenderDrawColor(renderer, 255, 80, 80, 255);
+        SDL_RenderFillRects(renderer, bars + firstSlowBucket, numberOfBuckets - firstSlowBucket);
+    }
+    
+    // The area a cell can cover whatever its type, since the cell images are not all the same size
+    SDL_Rect cellRegion(const GameBoard::CellPosition& cellPosition) {
+        auto region = SDL_Rect{gameBoardRect.x + cellWidth*cellPosition.column, gameBoardRect.y + cellHeight*cellPosition.row, cellWidth, cellHeight};
+        for (size_t cell = 0; cell < CandyCrush::numberOfCellTypes; cell++) {
+            auto cellRect = rectForCellPosition(cellPosition, (CandyCrush::Cell)cell);
+            SDL_UnionRect(&region, &cellRect, &region);
+        }
+        return region;
+    }
+    
+    // The area renderNumber draws the number in
+    SDL_Rect numberRect(const DigitStrip& strip, int number, int x, int y) const {
+        auto rect = SDL_Rect{x, y, 0, 0};
+        do {
+            const auto& source = strip.digits[number % 10];
+            rect.w += source.w;
+            rect.h = std::max(rect.h, source.h);
+            number /= 10;
+        } while (number > 0);
+        return rect;
+    }
+    
+    // Starts looking for a hint as soon as moves can be made on the board and cancels the search when they can not
+    void updateHintSearch(std::chrono::steady_clock::time_point now) {
+        if (hintEngine == nullptr) {
+            return;
+        }
+        if (!canMakeMoves()) {
+            if (isSearchingForHint) {
+                hintEngine->cancel();
+                isSearchingForHint = false;
+            }
+        } else if (!isSearchingForHint) {
+            hintEngine->search(game());
+            isSearchingForHint = true;
+            hintSearchStartTime = now;
+        }
+    }
+    
+    std::chrono::steady_clock::time_point hintTime() const {
+        auto hintDelay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(hintDelaySeconds));
+        return std::max(hintSearchStartTime, lastClickTime) + hintDelay;
+    }
+    
+    // Never waits for the search, if it has not found anything yet there is no hint
+    bool hintToShow(std::chrono::steady_clock::time_point now, HintEngine::Hint& hint) {
+        return isSearchingForHint && now >= hintTime() && hintEngine->bestHint(hint);
+    }
+    
+    // Repaints the parts of the board at rest that differ from what is shown, returns whether anything was repainted
+    bool renderIdleGameBoard(std::chrono::steady_clock::time_point now) {
+        const auto& gameBoard = game().getGameBoard();
+        auto selectedCell = cellPositionFromCoordinates(lastMouseDownX, lastMouseDownY);
+        if (!gameBoard.isCellValid(selectedCell)) {
+            selectedCell = GameBoard::CellPosition(-1, -1);
+        }
+        auto score = game().getScore();
+        auto secondsLeft = game().numberOfSecondsLeft();
+        HintEngine::Hint hint;
+        auto isShowingHint = hintToShow(now, hint);
+        
+        dirtyRects.clear();
+        if (shownScreen.screen != Screen::Board) {
+            dirtyRects.push_back(SDL_Rect{0, 0, windowWidth, windowHeight});
+        } else {
+            for (auto row = 0; row < gameBoard.rows; row++) {
+                for (auto column = 0; column < gameBoard.columns; column++) {
+                    if (gameBoard[row][column] != shownScreen.gameBoard[row][column]) {
+                        dirtyRects.push_back(cellRegion(GameBoard::CellPosition(row, column)));
                     }
-                    
-                    if (fromDestination.x != toDestination.x || fromDestination.y != toDestination.y) {
-                        finishedRendering = false;
+                }
+            }
+            if (selectedCell.row != shownScreen.selectedCell.row || selectedCell.column != shownScreen.selectedCell.column) {
+                for (const auto& cell: {selectedCell, shownScreen.selectedCell}) {
+                    if (gameBoard.isCellValid(cell)) {
+                        dirtyRects.push_back(cellRegion(cell));
                     }
-                    
-                    // Parts of the new cells animating from above should be visible before they have reched the top row
-                    auto extendedGameBoardY = gameBoardRect.y-18;
-                    
-                    // Handle animation from over the board
-                    auto cutoff = std::max(extendedGameBoardY-fromDestination.y, 0);
-                    int w, h;
-                    SDL_QueryTexture(image, NULL, NULL, &w, &h);
-                    SDL_Rect srcRect = {0,cutoff,w,h-cutoff};
-                    
-                    if (fromDestination.y < extendedGameBoardY) {
-                        fromDestination.y = extendedGameBoardY;
-                        fromDestination.h -= cutoff;
+                }
+            }
+            auto hasHintChanged = isShowingHint != shownScreen.isShowingHint
+            || (isShowingHint && !(hint.move.from == shownScreen.hintedMove.from && hint.move.to == shownScreen.hintedMove.to));
+            if (hasHintChanged) {
+                if (shownScreen.isShowingHint) {
+                    dirtyRects.push_back(cellRegion(shownScreen.hintedMove.from));
+                    dirtyRects.push_back(cellRegion(shownScreen.hintedMove.to));
+                }
+                if (isShowingHint) {
+                    dirtyRects.push_back(cellRegion(hint.move.from));
+                    dirtyRects.push_back(cellRegion(hint.move.to));
+                }
+            }
+            if (score != shownScreen.score) {
+                auto oldRect = numberRect(scoreDigits, shownScreen.score, 20 + scoreLabel.width, 20);
+                auto newRect = numberRect(scoreDigits, score, 20 + scoreLabel.width, 20);
+                SDL_UnionRect(&oldRect, &newRect, &newRect);
+                dirtyRects.push_back(newRect);
+            }
+            if (secondsLeft != shownScreen.secondsLeft) {
+                auto oldRect = numberRect(timeLeftDigits, shownScreen.secondsLeft, 80, 415);
+                auto newRect = numberRect(timeLeftDigits, secondsLeft, 80, 415);
+                SDL_UnionRect(&oldRect, &newRect, &newRect);
+                dirtyRects.push_back(newRect);
+            }
+        }
+        if (dirtyRects.empty()) {
+            return false;
+        }
+        
+        // Everything is drawn in the same order as in a full frame, the clip rect keeps the drawing inside the dirty region
+        for (const auto& dirtyRect: dirtyRects) {
+            SDL_RenderSetClipRect(renderer, &dirtyRect);
+            renderBackground();
+            renderScore(score);
+            renderNumber(timeLeftDigits, secondsLeft, 80, 415);
+            if (gameBoard.isCellValid(selectedCell)) {
+                auto selectedCellRect = rectForCellPosition(selectedCell, CandyCrush::Blue);
+                SDL_SetRenderDrawColor(renderer, 255, 80, 80, 1);
+                renderCounters.drawCalls++;
+                SDL_RenderDrawRect(renderer, &selectedCellRect);
+            }
+            if (isShowingHint) {
+                SDL_Rect hintRects[] = {rectForCellPosition(hint.move.from, CandyCrush::Blue), rectForCellPosition(hint.move.to, CandyCrush::Blue)};
+                SDL_SetRenderDrawColor(renderer, 255, 220, 80, 1);
+                renderCounters.drawCalls++;
+                SDL_RenderDrawRects(renderer, hintRects, 2);
+            }
+            for (auto row = 0; row < gameBoard.rows; row++) {
+                for (auto column = 0; column < gameBoard.columns; column++) {
+                    auto cellPosition = GameBoard::CellPosition(row, column);
+                    auto region = cellRegion(cellPosition);
+                    if (SDL_HasIntersection(&region, &dirtyRect)) {
+                        addSprite(gameBoard[row][column], rectForCellPosition(cellPosition, gameBoard[row][column]));
                     }
-                    SDL_RenderCopy(renderer, image, &srcRect, &fromDestination);
                 }
             }
+            renderSprites();
+        }
+        SDL_RenderSetClipRect(renderer, nullptr);
+        
+        shownScreen.screen = Screen::Board;
+        shownScreen.gameBoard = gameBoard;
+        shownScreen.selectedCell = selectedCell;
+        shownScreen.score = score;
+        shownScreen.secondsLeft = secondsLeft;
+        shownScreen.isShowingHint = isShowingHint;
+        shownScreen.hintedMove = hint.move;
+        return true;
+    }
+    
+    // Renders the frame shown at the given time if anything has changed, returns whether there is a frame to present.
+    // Nothing here waits, so that events keep being handled.
+    bool renderFrame(std::chrono::steady_clock::time_point now) {
+        TRACE_SPAN("renderFrame");
+        TRACE_COUNTER("queuedBoardSteps", boardAnimations.size());
+        if (!boardAnimations.empty()) {
+            shownScreen.screen = Screen::Nothing;
+            if (!hasAnimationStarted) {
+                hasAnimationStarted = true;
+                animationStartTime = now;
+            }
+            auto seconds = std::chrono::duration<double>(now - animationStartTime).count();
+            auto hasFinished = renderGameBoard(boardAnimations.front(), seconds);
+            if (hasFinished) {
+                boardAnimations.pop_front();
+                animationStartTime = now;
+                hasAnimationStarted = !boardAnimations.empty();
+            }
             
-            
-            SDL_RenderPresent(renderer);
-            SDL_Delay(3);
-            distance += distanceStep;
+            // When the last step has finished the frame is drawn again below with the board at rest
+            if (!hasFinished || !boardAnimations.empty()) {
+                return true;
+            }
+        }
+        if (!isShowingGameOver && !isFirstGame && isGameUpToDate() && game().gameOver()) {
+            isShowingGameOver = true;
+            gameOverStartTime = now;
+            gameThread->saveReplay();
+        }
+        if (isShowingGameOver) {
+            if (shownScreen.screen == Screen::GameOver) {
+                return false;
+            }
+            auto seconds = std::chrono::duration<double>(now - gameOverStartTime).count();
+            renderGameOver(seconds);
+            shownScreen.screen = seconds >= secondsUntilGameOverText() ? Screen::GameOver : Screen::Nothing;
+            return true;
         }
-        //        auto currentTime = std::chrono::high_resolution_clock::now();
-        //        int numberOfMilliSecondsElapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(currentTime-startTime).count();
-        //        std::cout << "Rendering took: " << numberOfMilliSecondsElapsed << "ms" << std::endl;
+        if (isFirstGame) {
+            if (shownScreen.screen == Screen::Start) {
+                return false;
+            }
+            renderBackground();
+            renderText(messageLabel, "Click to start", 360, 250, scoreLabelFont);
+            shownScreen.screen = Screen::Start;
+            return true;
+        }
+        return renderIdleGameBoard(now);
     }
     
-    void renderGameBoard() {
-        auto gameBoardChange = CandyCrushGameBoardChange(game);
-        renderGameBoard(gameBoardChange);
+    // Whether the next frame differs from the last one even if there is no input
+    bool isAnimating() const {
+        return !boardAnimations.empty() || (isShowingGameOver && shownScreen.screen != Screen::GameOver);
     }
     
-    GameBoard::CellPosition cellPositionFromCoordinates(int x, int y) const {
-        return GameBoard::CellPosition((y-gameBoardRect.y)/cellHeight, (x-gameBoardRect.x)/cellWidth);
+    // Moves can only be made when the board that is shown is the board of the game
+    bool canMakeMoves() const {
+        return !isFirstGame && !isShowingGameOver && boardAnimations.empty() && isGameUpToDate() && !game().gameOver();
     }
     
-    void run() {
-        bool quit = false;
-        bool isMouseDown = false;
-        SDL_Event e;
+    bool canStartNewGame() const {
+        auto gameOverTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - gameOverStartTime).count();
+        return isFirstGame || (isShowingGameOver && gameOverTime >= gameOverSeconds());
+    }
+    
+    // The game as of the latest snapshot
+    const CandyCrush& game() const {
+        return gameThread->snapshot().game;
+    }
+    
+    // Whether the snapshot includes every move and new game sent to the game thread
+    bool isGameUpToDate() const {
+        return gameThread->snapshot().numberOfCommands == gameThread->numberOfCommands();
+    }
+    
+    // Takes the latest snapshot of the game and queues the steps the game thread has made since the last time for animation.
+    // The steps are taken after the snapshot, so all steps of the moves in the snapshot are taken.
+    void receiveGameUpdates() {
+        gameThread->updateSnapshot();
+        GameThread::BoardStep boardStep;
+        while (gameThread->popBoardStep(boardStep)) {
+            boardAnimations.push_back({boardStep.gameBoard, boardStep.gameBoardChange, boardStep.score, cellPixelsPerSecond});
+        }
         
-        auto renderCallback = [&](CandyCrushGameBoardChange gameBoardChange) {
-            renderGameBoard(gameBoardChange);
-        };
+        if (isStartingNewGame && isGameUpToDate()) {
+            isStartingNewGame = false;
+            
+            // Intro animation - all cells falls from the top in a triangular fashion
+            CandyCrushGameBoardChange triangularFallGameBoardChange;
+            for (auto row = 0; row < game().getGameBoard().rows; row++) {
+                for (auto column = 0; column < game().getGameBoard().columns; column++) {
+                    auto cell = game().getGameBoard()[row][column];
+                    triangularFallGameBoardChange.movedCells.push_back({{row, column}, {row-(int)game().getGameBoard().rows-(int)game().getGameBoard().columns+1+column, column}, cell});
+                }
+            }
+            
+            boardAnimations.push_back({game().getGameBoard(), triangularFallGameBoardChange, game().getScore(), 3*cellPixelsPerSecond});
+        }
+    }
+    
+    // The steps of the move come back from the game thread and are animated one after another by the following frames
+    void play(GameBoard::CellSwapMove move) {
+        if (isSearchingForHint) {
+            hintEngine->cancel();
+            isSearchingForHint = false;
+        }
+        gameThread->play(move);
+    }
+    
+    void startNewGame(uint64_t seed, CandyCrush::Clock clock = CandyCrush::Clock::wallClock()) {
+        lastMouseDownX = -1;
+        lastMouseDownY = -1;
+        isFirstGame = false;
+        isShowingGameOver = false;
+        isStartingNewGame = true;
+        gameThread->startNewGame(seed, clock);
+    }
+    
+    // Waits until the game thread has handled everything sent to it, only the benchmark needs to
+    void waitForGame() {
+        receiveGameUpdates();
+        while (!isGameUpToDate()) {
+            std::this_thread::yield();
+            receiveGameUpdates();
+        }
+    }
+    
+    void handleEvent(const SDL_Event& e) {
+        if( e.type == SDL_QUIT ) {
+            quit = true;
+        }
         
-        bool hasShownGameOver = false;
+        if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_f) {
+            isShowingFrameTimes = !isShowingFrameTimes;
+            shownScreen.screen = Screen::Nothing;
+        }
         
-        while( !quit ) {
-            if (game.gameOver()) {
-                if (!hasShownGameOver) {
-                    hasShownGameOver = true;
-                    renderGameOver();
-                    SDL_RenderPresent(renderer);
-                    SDL_Delay(2000);
+        // The first press starts recording a trace of all threads and the second one saves it
+        if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_t) {
+            if (Trace::isRecording()) {
+                Trace::stop();
+                if (!Trace::save(tracePath)) {
+                    printf("Could not save the trace to %s\n", tracePath);
                 }
-            } else if (isFirstGame) {
-                renderBackground();
-                renderText("Click to start", 360, 250, scoreLabelFont);
-                SDL_RenderPresent(renderer);
             } else {
-                renderGameBoard();
+                Trace::start();
             }
-            
-            while( SDL_PollEvent( &e ) != 0 ) {
-                if( e.type == SDL_QUIT ) {
-                    quit = true;
-                }
-                
-                // Handle clicks
-                if (e.type == SDL_MOUSEBUTTONDOWN){
-                    if (isFirstGame || game.gameOver()) {
-                        lastMouseDownX = -1;
-                        lastMouseDownY = -1;
-                        isFirstGame = false;
-                        game = CandyCrush();
-                        hasShownGameOver = false;
-                        
-                        // Intro animation - all cells falls from the top in a triangular fashion
-                        CandyCrushGameBoardChange triangularFallGameBoardChange(game);
-                        for (auto row = 0; row < game.getGameBoard().rows; row++) {
-                            for (auto column = 0; column < game.getGameBoard().columns; column++) {
-                                auto pair = triangularFallGameBoardChange.gameBoardChange[{row, column}];
-                                triangularFallGameBoardChange.gameBoardChange[{row, column}] = {{row-(int)game.getGameBoard().rows-(int)game.getGameBoard().columns+1+column, column}, pair.second};
-                            }
-                        }
-                        
-                        renderGameBoard(triangularFallGameBoardChange,3);
-                    } else {
-                        isMouseDown = true;
-                        int x, y;
-                        SDL_GetMouseState(&x, &y);
-                        auto move = GameBoard::CellSwapMove(cellPositionFromCoordinates(x, y), cellPositionFromCoordinates(lastMouseDownX, lastMouseDownY));
-                        if (game.getGameBoard().areCellsAdjacent(move.from, move.to)) {
-                            lastMouseDownX = -1;
-                            lastMouseDownY = -1;
-                            game.play(move, renderCallback);
-                            
-                        } else {
-                            lastMouseDownX = x;
-                            lastMouseDownY = y;
-                        }
-                        renderGameBoard();
-                    }
+        }
+        
+        // The window lost what it showed, or the frame texture lost its content
+        if ((e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED) || e.type == SDL_RENDER_TARGETS_RESET) {
+            shownScreen.screen = Screen::Nothing;
+        }
+        
+        // Handle clicks
+        if (e.type == SDL_MOUSEBUTTONDOWN){
+            lastClickTime = std::chrono::steady_clock::now();
+            if (canStartNewGame()) {
+                startNewGame(CandyCrush::randomSeed());
+            } else if (canMakeMoves()) {
+                isMouseDown = true;
+                int x, y;
+                SDL_GetMouseState(&x, &y);
+                auto move = GameBoard::CellSwapMove(cellPositionFromCoordinates(x, y), cellPositionFromCoordinates(lastMouseDownX, lastMouseDownY));
+                if (game().getGameBoard().areCellsAdjacent(move.from, move.to)) {
+                    lastMouseDownX = -1;
+                    lastMouseDownY = -1;
+                    play(move);
+                    
+                } else {
+                    lastMouseDownX = x;
+                    lastMouseDownY = y;
                 }
-                
-                if (e.type == SDL_MOUSEBUTTONUP && lastMouseDownX != -1) {
-                    isMouseDown = false;
+            }
+        }
+        
+        if (e.type == SDL_MOUSEBUTTONUP && lastMouseDownX != -1) {
+            isMouseDown = false;
+        }
+        
+        // Handle drag event
+        if (e.type == SDL_MOUSEMOTION && isMouseDown && canMakeMoves()) {
+            int x, y;
+            SDL_GetMouseState(&x, &y);
+            auto move = GameBoard::CellSwapMove(cellPositionFromCoordinates(x, y), cellPositionFromCoordinates(lastMouseDownX, lastMouseDownY));
+            if (game().getGameBoard().areCellsAdjacent(move.from, move.to)) {
+                lastMouseDownX = -1;
+                lastMouseDownY = -1;
+                play(move);
+            }
+        }
+    }
+    
+    // Plays scripted moves of a seeded game and renders every frame of their animations, the game over animation included,
+    // as if the frames were shown at 60 Hz but without waiting for the display. Before every move the cell it starts from
+    // is selected, which takes a frame that only repaints dirty regions. Prints the CPU time it took to render and present
+    // the frames and the draw calls and texture uploads per frame as JSON.
+    //
+    // The game is played on a virtual clock where a move takes a second plus a quarter of a second per wave, like in the
+    // simulator, so every run plays the same moves and ends the game at the same move however fast the machine is. Frame
+    // times are CPU time of this thread, which the game thread and other processes do not add to.
+    void runBenchmark(uint64_t seed, int numberOfMoves) {
+        std::vector<double> frameMilliseconds;
+        auto frameTime = std::chrono::steady_clock::now();
+        auto renderBenchmarkFrame = [&]() {
+            auto renderStartCpuTime = ThreadCpuClock::now();
+            if (renderFrame(frameTime)) {
+                presentFrame();
+                auto milliseconds = std::chrono::duration<double, std::milli>(ThreadCpuClock::now() - renderStartCpuTime).count();
+                frameMilliseconds.push_back(milliseconds);
+                recordFrameTime(milliseconds);
+            }
+            frameTime += std::chrono::microseconds(16667);
+        };
+        
+        RandomGenerator randomGenerator(seed);
+        startNewGame(seed, CandyCrush::Clock::virtualClock(1000, 250));
+        waitForGame();
+        renderCounters = RenderCounters();
+        auto startClock = std::clock();
+        auto startTime = std::chrono::steady_clock::now();
+        for (auto move = 0; move < numberOfMoves && !game().gameOver(); move++) {
+            while (isAnimating()) {
+                renderBenchmarkFrame();
+            }
+            auto moves = game().legalMoves();
+            auto cellSwapMove = moves[randomGenerator.nextBelow((uint32_t)moves.size())];
+            lastMouseDownX = gameBoardRect.x + cellSwapMove.from.column*cellWidth + cellWidth/2;
+            lastMouseDownY = gameBoardRect.y + cellSwapMove.from.row*cellHeight + cellHeight/2;
+            renderBenchmarkFrame();
+            lastMouseDownX = -1;
+            lastMouseDownY = -1;
+            play(cellSwapMove);
+            waitForGame();
+        }
+        while (isAnimating() || (game().gameOver() && !isShowingGameOver)) {
+            renderBenchmarkFrame();
+        }
+        auto totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        auto cpuSeconds = (double)(std::clock() - startClock) / CLOCKS_PER_SEC;
+        
+        std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+        auto percentile = [&](double fraction) {
+            return frameMilliseconds.empty() ? 0 : frameMilliseconds[(size_t)(fraction * (frameMilliseconds.size() - 1))];
+        };
+        auto frames = std::max<size_t>(frameMilliseconds.size(), 1);
+        std::cout << "{\"benchmark\": \"renderFrames\""
+        << ", \"frames\": " << frameMilliseconds.size()
+        << ", \"framesPerSecond\": " << (long)(frameMilliseconds.size() / totalSeconds)
+        << ", \"cpuSeconds\": " << cpuSeconds
+        << ", \"p50Milliseconds\": " << percentile(0.5)
+        << ", \"p90Milliseconds\": " << percentile(0.9)
+        << ", \"p99Milliseconds\": " << percentile(0.99)
+        << ", \"maxMilliseconds\": " << percentile(1.0)
+        << ", \"drawCallsPerFrame\": " << (double)renderCounters.drawCalls / frames
+        << ", \"textureUploadsPerFrame\": " << (double)renderCounters.textureUploads / frames
+        << "}" << std::endl;
+    }
+    
+    void run() {
+        SDL_Event e;
+        
+        // Frames are paced by vsync, this only keeps the loop from spinning when the renderer does not wait for it
+        const auto minimumFrameTime = std::chrono::milliseconds(8);
+        
+        while( !quit ) {
+            auto frameStartTime = std::chrono::steady_clock::now();
+            
+            // When nothing is moving the loop sleeps until there is input, the timer shows another second or a hint is due
+            if (!isAnimating()) {
+                auto isCountingDown = !isFirstGame && !isShowingGameOver;
+                auto timeout = isCountingDown ? game().numberOfMillisecondsUntilNextSecond() : -1;
+                if (isSearchingForHint && frameStartTime < hintTime()) {
+                    auto millisecondsUntilHint = (int)std::chrono::duration_cast<std::chrono::milliseconds>(hintTime() - frameStartTime).count() + 1;
+                    timeout = timeout < 0 ? millisecondsUntilHint : std::min(timeout, millisecondsUntilHint);
                 }
-                
-                // Handle drag event
-                if (e.type == SDL_MOUSEMOTION && isMouseDown && !game.gameOver()) {
-                    int x, y;
-                    SDL_GetMouseState(&x, &y);
-                    auto move = GameBoard::CellSwapMove(cellPositionFromCoordinates(x, y), cellPositionFromCoordinates(lastMouseDownX, lastMouseDownY));
-                    if (game.getGameBoard().areCellsAdjacent(move.from, move.to)) {
-                        lastMouseDownX = -1;
-                        lastMouseDownY = -1;
-                        game.play(move, renderCallback);
-                        renderGameBoard();
-                    }
+                auto hasEvent = timeout < 0 ? SDL_WaitEvent(&e) : SDL_WaitEventTimeout(&e, timeout);
+                if (hasEvent != 0) {
+                    handleEvent(e);
                 }
             }
-            SDL_Delay(10);
+            while( SDL_PollEvent( &e ) != 0 ) {
+                handleEvent(e);
+            }
+            receiveGameUpdates();
+            updateHintSearch(std::chrono::steady_clock::now());
+            
+            auto renderStartTime = std::chrono::steady_clock::now();
+            if (renderFrame(renderStartTime)) {
+                presentFrame();
+                recordFrameTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStartTime).count());
+            }
+            
+            auto frameTime = std::chrono::steady_clock::now() - frameStartTime;
+            if (isAnimating() && frameTime < minimumFrameTime) {
+                SDL_Delay((Uint32)std::chrono::duration_cast<std::chrono::milliseconds>(minimumFrameTime - frameTime).count());
+            }
         }
     }
 };
@@ -390,6 +1044,27 @@ struct GameEngine {
 #include <array>
 int main( int argc, char* args[] )
 {
+    // Headless benchmark of the rendering, with a trace of the whole run if a path for it is given:
+    //     King-Test --benchmark [seed] [moves] [trace]
+    if (argc > 1 && std::string(args[1]) == "--benchmark") {
+        
+        // Neither a display nor a GPU is needed, the dummy video driver works with the software renderer
+        setenv("SDL_VIDEODRIVER", "dummy", 1);
+        GameEngine gameEngine(true);
+        if (argc > 4) {
+            Trace::start();
+        }
+        gameEngine.runBenchmark(argc > 2 ? std::stoull(args[2]) : 1, argc > 3 ? std::stoi(args[3]) : 100);
+        if (argc > 4) {
+            Trace::stop();
+            if (!Trace::save(args[4])) {
+                printf("Could not save the trace to %s\n", args[4]);
+                return 1;
+            }
+        }
+        return 0;
+    }
+    
     GameEngine gameEngine;
     gameEngine.run();
     return 0;